@@ -4,10 +4,14 @@
 #include <pigpio.h>
 #include <signal.h>
 #include <pthread.h>
+#include <stdatomic.h>
 #include <string.h>
 #include <stdlib.h>
 #include <time.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <netinet/in.h>
 #include <sys/socket.h>
 #include "./src/cjson/cJSON.h"
@@ -34,9 +38,11 @@
 #define ADC_ADDR 0x4b
 
 #include "raylib.h"
+#include "rlgl.h"
 #define RAYGUI_IMPLEMENTATION
 #include "./src/raygui.h"
 #include "./src/raygui/styles/dark/style_dark.h"
+#include "./src/image/art_image.h"
 
 #define SCREEN_WIDTH 800
 #define SCREEN_HEIGHT 480
@@ -44,23 +50,160 @@
 #define PLAYLIST_WIDTH 120
 #define PLAYLIST_HEIGHT 120
 
-#define MAX_PLAYLISTS 10
+// playback commands waiting for the command worker, presses beyond this are dropped
+#define COMMAND_QUEUE_SIZE 16
+// how long a failed command message stays on the music view
+#define COMMAND_ERROR_MS 3000
+
+// client side budget for api.spotify.com, tokens refill continuously
+#define RATE_BUCKET_SIZE 20
+#define RATE_REFILL_PER_SEC 4
+// the last few tokens are kept for user controls
+#define RATE_INTERACTIVE_RESERVE 5
+// used when a 429 has no usable Retry-After
+#define RATE_DEFAULT_RETRY_S 2
+#define RATE_MAX_POLL_BACKOFF 8
+
+// warm easy handles kept per host, extra concurrent requests get a throwaway handle
+#define HTTP_POOL_SIZE 4
+// response bodies come from recycled buffers in power of 4 size classes,
+// 4 KiB up to 1 MiB, anything bigger is a plain malloc
+#define BODY_POOL_CLASSES 5
+#define BODY_POOL_MIN_BYTES 4096
+#define BODY_POOL_DEPTH 4
+// a Content-Length above this is not trusted for presizing
+#define BODY_PRESIZE_MAX (8 * 1024 * 1024)
+
+// renew the access token this long before spotify expires it
+#define TOKEN_REFRESH_MARGIN_MS (5 * 60 * 1000)
+#define TOKEN_RETRY_MS (15 * 1000)
+
+// how often the poller refreshes /me/player, the UI interpolates progress in between
+#define STATE_POLL_MS 1000
+#define STATE_POLL_SLICE_MS 50
+
+// album art is downloaded and decoded off the render thread, only the gpu
+// upload happens in the frame and at most this many per frame
+#define ART_SIZE 256
+// grid thumbnails are drawn about this wide
+#define ART_THUMB_SIZE (PLAYLIST_WIDTH - 20)
+// spotify lists 640, 300 and 64 (60 for playlists) pixel versions of each image
+#define ART_VARIANTS 4
+#define ART_WORKERS 2
+#define ART_UPLOADS_PER_FRAME 2
+// a failed image is asked for again after this long
+#define ART_RETRY_MS 5000
+
+// every grid thumbnail lives in one cache keyed by image url. the cached
+// thumbnails share one atlas texture so the grid draws without rebinding,
+// each entry owns a fixed cell and cell 0 is the placeholder. the atlas is
+// allocated whole up front, so its size is the vram the cache costs (4 MiB
+// RGBA8, 512 KiB ETC at 1024) and its cell count caps the entries, the least
+// recently drawn one gives up its cell when a new url needs one
+#ifndef THUMB_ATLAS_SIZE
+#define THUMB_ATLAS_SIZE 1024
+#endif
+// keeps every cell on a 4x4 block boundary for compressed updates
+#define THUMB_ATLAS_PAD 4
+// ui icons are packed into rows of this width at startup
+#define ICON_ATLAS_WIDTH 512
+#define THUMB_CELL (ART_THUMB_SIZE + 2 * THUMB_ATLAS_PAD)
+#define THUMB_ATLAS_COLS (THUMB_ATLAS_SIZE / THUMB_CELL)
+#define TEXTURE_CACHE_ENTRIES (THUMB_ATLAS_COLS * THUMB_ATLAS_COLS - 1)
+#define TEXTURE_CACHE_BUCKETS 128
+
+// art is encoded to ETC1 before it is cached when the driver takes ETC2
+// textures (ETC1 blocks are valid ETC2 and ETC2 allows sub image updates),
+// an eighth of RGBA8. PITHING_ETC=0 in the environment keeps RGBA8
+
+// compressed sub image updates are the one thing rlgl has no wrapper for. the
+// call has the same signature in GL 1.3 and GLES 2.0 and both libGL and
+// libGLESv2 export it, so it's declared here rather than pulling in the
+// headers of one api
+extern void glCompressedTexSubImage2D(unsigned int target, int level, int xoffset, int yoffset,
+    int width, int height, unsigned int format, int image_size, const void *data);
+#define ART_GL_TEXTURE_2D 0x0DE1
+
+// decoded art is kept in one packed file under $XDG_CACHE_HOME/pithing,
+// an index block followed by fixed size slots reused round robin
+#define ART_CACHE_ENTRIES 128
+#define ART_CACHE_SLOT_BYTES (ART_SIZE * ART_SIZE * 4)
+// slots start here so every one of them can be mmapped on its own
+#define ART_CACHE_INDEX_BYTES 65536
+#define ART_CACHE_MAGIC 0x43414950
+#define ART_CACHE_VERSION 2
 
 volatile int running = 1;
 volatile bool logged_in = false;
-volatile bool needs_reload = false;
-char new_album_art_url[256] = {0};
-pthread_mutex_t album_art_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// one entry of spotify's images[], width is 0 when spotify doesn't know it
+typedef struct {
+    char url[256];
+    int width;
+} ImageVariant;
 
 typedef struct {
     char title[128];
     char artist[128];
     char album[128];
-    char url[256]; 
+    ImageVariant images[ART_VARIANTS];
+    int image_count;
     int progress;
     int duration;
 } SongInfo;
 
+// spotify responses the ui keeps are decoded once into these, strings of a
+// response are deduplicated into one pool and referenced by offset
+#define SPOTIFY_ID_LEN 22
+#define DEVICE_ID_LEN 40
+#define STRING_POOL_INITIAL 1024
+
+// offset into a StringPool, 0 is the empty string
+typedef uint32_t StrRef;
+
+typedef struct {
+    char *data;
+    uint32_t used;
+    uint32_t capacity;
+    // open addressing over offsets into data, 0 marks a free slot
+    uint32_t *slots;
+    uint32_t slot_count;
+    uint32_t count;
+} StringPool;
+
+typedef struct {
+    char id[SPOTIFY_ID_LEN + 1];
+    StrRef name;
+    // the variant art_pick_variant() picked for a grid thumbnail
+    StrRef image_url;
+    int track_count;
+} Playlist;
+
+// playlist tracks are only ever played, so the page is fetched with
+// fields=items(track(uri)) and the uri is all there is
+typedef struct {
+    StrRef uri;
+} Track;
+
+typedef struct {
+    char id[DEVICE_ID_LEN + 1];
+    char name[64];
+    int volume;
+    bool active;
+} Device;
+
+typedef struct {
+    Playlist *items;
+    int count;
+    StringPool strings;
+} PlaylistList;
+
+typedef struct {
+    Track *items;
+    int count;
+    StringPool strings;
+} TrackList;
+
 typedef enum {
     PLAYLIST,
     ALBUM
@@ -70,13 +213,14 @@ typedef struct {
     char client_name[256];
     char client_id[256];
     char client_secret[256];
-    char access_token[256];
     char refresh_token[256];
     char current_playing_id[256];
     char current_track_id[256];
     char current_playlist_id[256];
-    cJSON *playlists;
-    int expiry;
+    // filled by on_playlists_fetched(), the home screen takes it over
+    PlaylistList playlists;
+    // monotonic ms, see get_current_time()
+    uint64_t expiry;
     int refresh_timer;
     int refresh_timeout;
     int volume;
@@ -94,11 +238,95 @@ typedef enum {
     STATE_APP_LIBRARY
 } AppState;
 
+// response body, release it with body_release()
 typedef struct {
     char *memory;
     size_t size;
+    size_t capacity;
+    // handle the body arrives on, asked for Content-Length on the first chunk
+    CURL *curl;
 } MemoryBuffer;
 
+typedef struct {
+    pthread_mutex_t mutex;
+    char *free[BODY_POOL_CLASSES][BODY_POOL_DEPTH];
+    int count[BODY_POOL_CLASSES];
+    unsigned hits;
+    unsigned misses;
+    unsigned oversize;
+    unsigned presized;
+    unsigned grown;
+} BodyPool;
+
+// incremental json scanner, only keeps the path to the current value so the
+// hot /me/player response never needs a body buffer or a cJSON tree
+#define JSON_STREAM_FRAMES 8
+#define JSON_STREAM_KEY 32
+#define JSON_STREAM_MAX_DEPTH 64
+
+typedef enum {
+    JSON_VALUE_STRING,
+    JSON_VALUE_NUMBER,
+    JSON_VALUE_TRUE,
+    JSON_VALUE_FALSE,
+    JSON_VALUE_NULL
+} JsonValueKind;
+
+typedef enum {
+    JS_VALUE,
+    JS_KEY,
+    JS_COLON,
+    JS_AFTER,
+    JS_STRING,
+    JS_ESCAPE,
+    JS_UNICODE,
+    JS_LITERAL
+} JsonStreamState;
+
+typedef struct {
+    int index;
+    char key[JSON_STREAM_KEY];
+} JsonFrame;
+
+typedef struct {
+    JsonFrame frames[JSON_STREAM_FRAMES];
+    // one bit per open container, set for arrays
+    uint64_t array_bits;
+    int depth;
+    JsonStreamState state;
+    bool string_is_key;
+    char token[256];
+    size_t token_len;
+    unsigned codepoint;
+    unsigned high_surrogate;
+    int hex_left;
+    bool started;
+    bool done;
+    bool failed;
+    // called for every scalar that sits within JSON_STREAM_FRAMES levels,
+    // path looks like item.album.images[0].url
+    void (*on_value)(void *user, const char *path, JsonValueKind kind, const char *text);
+    void *user;
+} JsonStream;
+
+// fields fetch_current_state() pulls out of /me/player while it streams in
+typedef struct {
+    SongInfo *song;
+    char track_id[256];
+    Device device;
+    bool is_playing;
+    bool shuffle;
+    bool error;
+} PlayerExtract;
+
+// current access token, written by the login and the refresher and read
+// lock free by every request, same scheme as SnapshotBuffer
+typedef struct {
+    char slots[2][256];
+    atomic_uint seq[2];
+    atomic_int current;
+} TokenStore;
+
 typedef struct {
     char client_id[256];
     char client_secret[256];
@@ -106,31 +334,276 @@ typedef struct {
     char redirect_uri[256];
 } AuthData;
 
+// lower value wins, see sched_can_start()
+typedef enum {
+    PRIO_INTERACTIVE,
+    PRIO_STATE,
+    PRIO_ART,
+    PRIO_BROWSE,
+    PRIO_PREFETCH,
+    PRIO_COUNT
+} RequestPriority;
+
 typedef struct {
-    char endpoint[512];
-    bool usePost;
-    char access_token[256];
-} NetCmdData;
-
-typedef struct { 
-    Texture2D back;
-    Texture2D music;
-    Texture2D home;
-    Texture2D library;
-    Texture2D play;
-    Texture2D pause;
-    Texture2D skip;
-    Texture2D prev;
+    int active[PRIO_COUNT];
+    int waiting[PRIO_COUNT];
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+} Scheduler;
+
+typedef struct {
+    double tokens;
+    uint64_t last_refill;
+    // nothing goes to the api before this after a 429
+    uint64_t blocked_until;
+    // multiplier on the poll interval, grows on 429 and decays on success
+    int poll_backoff;
+    uint32_t throttled;
+    pthread_mutex_t mutex;
+} RateLimiter;
+
+typedef enum {
+    HOST_API,
+    HOST_ACCOUNTS,
+    HOST_IMAGES,
+    HOST_OTHER,
+    HOST_COUNT
+} HttpHost;
+
+// buckets for the per endpoint byte counters
+typedef enum {
+    EP_PLAYER_STATE,
+    EP_PLAYER_COMMAND,
+    EP_ME,
+    EP_LIBRARY,
+    EP_PLAYLISTS,
+    EP_PLAYLIST_TRACKS,
+    EP_TOKEN,
+    EP_IMAGES,
+    EP_OTHER,
+    EP_COUNT
+} ApiEndpoint;
+
+typedef struct {
+    atomic_ullong bytes;
+    atomic_uint requests;
+} EndpointStats;
+
+typedef struct {
+    CURL *handles[HTTP_POOL_SIZE];
+    bool in_use[HTTP_POOL_SIZE];
+} HandlePool;
+
+// one request on the async engine, on_complete runs on the ui thread
+// from http_drain_completions() and the request is freed right after
+typedef struct HttpRequest {
+    char url[512];
+    const char *method;
+    char *payload;
+    RequestPriority priority;
+    void (*on_complete)(struct HttpRequest *req);
+    void *user;
+    CURLcode result;
+    long status;
+    MemoryBuffer response;
+    CURL *curl;
+    struct curl_slist *headers;
+    struct HttpRequest *next;
+} HttpRequest;
+
+typedef enum {
+    CMD_PLAY,
+    CMD_PAUSE,
+    CMD_NEXT,
+    CMD_PREVIOUS,
+    CMD_SHUFFLE,
+    CMD_VOLUME,
+    CMD_LIKE
+} CommandType;
+
+typedef enum {
+    CMD_STATUS_QUEUED,
+    CMD_STATUS_OK,
+    CMD_STATUS_FAILED,
+    // superseded by a later command before it was sent
+    CMD_STATUS_CANCELLED
+} CommandStatus;
+
+typedef struct {
+    CommandType type;
+    // volume percent or shuffle state
+    int value;
+    // track id for CMD_LIKE, track uri for CMD_PLAY (empty resumes)
+    char arg[256];
+    uint32_t id;
+    CommandStatus status;
+    long http_status;
+} PlayerCommand;
+
+// strict fifo in front of a single worker so presses reach spotify in order,
+// finished commands wait in done until the ui drains them
+typedef struct {
+    PlayerCommand queue[COMMAND_QUEUE_SIZE];
+    int head;
+    int count;
+    PlayerCommand done[COMMAND_QUEUE_SIZE];
+    int done_head;
+    int done_count;
+    uint32_t next_id;
+    uint32_t coalesced;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    pthread_t thread;
+} CommandLane;
+
+typedef struct {
+    CURLM *multi;
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    HttpRequest *pending[PRIO_COUNT];
+    HttpRequest *pending_tail[PRIO_COUNT];
+    // only touched by the engine thread
+    HttpRequest *active;
+    HttpRequest *completed;
+    HttpRequest *completed_tail;
+} HttpEngine;
+
+// every icon is a rectangle in one atlas texture
+typedef struct {
+    Texture2D atlas;
+    Rectangle back;
+    Rectangle music;
+    Rectangle home;
+    Rectangle library;
+    Rectangle play;
+    Rectangle pause;
+    Rectangle skip;
+    Rectangle prev;
     // white/green
-    Texture2D shuffle;
+    Rectangle shuffle;
     // spotify uses white/green so we use white/green
-    Texture2D like; 
-} UITextures;
+    Rectangle like; 
+} UIIcons;
+
+typedef enum {
+    ART_EMPTY,
+    ART_LOADING,
+    ART_READY,
+    ART_FAILED
+} ArtState;
+
+// one texture cache entry, only touched by the render thread
+typedef struct {
+    char url[256];
+    // the same url can be cached at more than one size
+    int size;
+    uint64_t hash;
+    // pixels live in atlas cell index + 1 once ready
+    ArtState state;
+    uint64_t failed_at;
+    bool used;
+    // frame the entry was last drawn in, a hit is counted once per frame
+    unsigned frame;
+    int lru_prev;
+    int lru_next;
+    int hash_next;
+} ArtSlot;
+
+// the now playing art never allocates a texture after startup, new art is
+// written into the hidden texture in place and then swapped in,
+// so the old cover stays up until the new pixels are on the gpu
+typedef struct {
+    Texture2D textures[2];
+    int front;
+    bool shown;
+    // art wanted right now, loading until it lands in the back texture
+    char url[256];
+    ArtState state;
+    uint64_t failed_at;
+    unsigned swaps;
+} NowPlayingArt;
+
+typedef struct {
+    Texture2D atlas;
+    ArtSlot slots[TEXTURE_CACHE_ENTRIES];
+    int buckets[TEXTURE_CACHE_BUCKETS];
+    // most recently used first
+    int lru_head;
+    int lru_tail;
+    unsigned frame;
+    unsigned hits;
+    unsigned misses;
+    unsigned evictions;
+} TextureCache;
+
+typedef struct ArtJob {
+    char url[256];
+    int size;
+    RequestPriority priority;
+    // goes to the now playing textures instead of the texture cache
+    bool now_playing;
+    // decoded and resized by the worker, or mapped from the disk cache,
+    // uploaded by art_upload_ready()
+    Image image;
+    bool mapped;
+    size_t map_bytes;
+    // disk cache slot pinned by the mapping
+    int map_slot;
+    struct ArtJob *next;
+} ArtJob;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t capacity;
+    uint32_t slot_bytes;
+    // slot the next store overwrites
+    uint32_t next;
+    uint32_t reserved;
+} ArtCacheHeader;
+
+typedef struct {
+    uint64_t hash;
+    char url[256];
+    int32_t width;
+    int32_t height;
+    int32_t format;
+    uint32_t bytes;
+    uint32_t valid;
+    uint32_t reserved;
+} ArtCacheEntry;
+
+// the index lives in memory as well, lookups never touch the file
+typedef struct {
+    pthread_mutex_t mutex;
+    int fd;
+    ArtCacheHeader header;
+    ArtCacheEntry entries[ART_CACHE_ENTRIES];
+    // live mappings of each slot, a store never overwrites a pinned slot since
+    // pages a MAP_PRIVATE mapping hasn't touched yet would show the new pixels
+    unsigned pins[ART_CACHE_ENTRIES];
+    unsigned hits;
+    unsigned misses;
+    unsigned stores;
+    // what the stored images take on disk and what they would as RGBA8
+    size_t stored_bytes;
+    size_t stored_rgba_bytes;
+} ArtCache;
+
+_Static_assert(sizeof(ArtCacheHeader) + ART_CACHE_ENTRIES * sizeof(ArtCacheEntry) <= ART_CACHE_INDEX_BYTES,
+    "art cache index does not fit in front of the first slot");
 
 typedef struct {
-    char id[256];
-    Texture2D texture;
-} PlaylistTexture;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    ArtJob *pending;
+    ArtJob *ready;
+    ArtJob *ready_tail;
+    pthread_t workers[ART_WORKERS];
+    unsigned decoded;
+    unsigned uploaded;
+    unsigned dropped;
+} ArtPipeline;
 
 typedef struct {
     Rectangle back;
@@ -153,39 +626,173 @@ typedef struct {
     bool like_pressed;
 } ControlsRegion;
 
+// complete view of the player as of one /me/player fetch
 typedef struct {
-    int limit;
-    int offset;
-} PlaylistArgs;
+    SongInfo song;
+    char track_id[256];
+    bool has_playback;
+    bool is_playing;
+    bool shuffle;
+    uint64_t fetched_at;
+} PlayerSnapshot;
+
+// single writer (state poller), many readers (render loop)
+// writer fills the slot that isn't published and then flips published,
+// readers copy the published slot and retry if its seq moved underneath them
+typedef struct {
+    PlayerSnapshot slots[2];
+    atomic_uint seq[2];
+    atomic_int published;
+} SnapshotBuffer;
 
 SpotifyClient spclient;
 pthread_mutex_t spclient_mutex = PTHREAD_MUTEX_INITIALIZER;
 pthread_mutex_t logged_in_mutex = PTHREAD_MUTEX_INITIALIZER;
 
-SongInfo current_song = {0};
-Texture2D albumTexture = {0};
-UITextures ui_textures = {0};
+static SnapshotBuffer player_state = {0};
+static TokenStore auth_token = {0};
+static atomic_bool token_refresh_requested = false;
+static atomic_bool state_refresh_requested = false;
+
+UIIcons ui_icons = {0};
 
 static Texture2D qrtexture = {0};
 static Texture2D shuffle_texture = {0};
-static PlaylistTexture playlist_textures[MAX_PLAYLISTS] = {0};
-static int texture_count = 0;
-static cJSON *cached_playlists = NULL;
+static TextureCache texture_cache = {0};
+static NowPlayingArt now_playing_art = {0};
+static ArtPipeline art_pipeline = { .mutex = PTHREAD_MUTEX_INITIALIZER, .cond = PTHREAD_COND_INITIALIZER };
+static ArtCache art_cache = { .mutex = PTHREAD_MUTEX_INITIALIZER, .fd = -1 };
+// format of every art texture and of the images the workers produce, set once after InitWindow()
+static atomic_int art_format = PIXELFORMAT_UNCOMPRESSED_R8G8B8A8;
+// owned by the render thread once taken from spclient
+static PlaylistList home_playlists = {0};
 static int display_vol = -1;
 static uint64_t volume_time = 0;
 static pthread_mutex_t volume_mutex = PTHREAD_MUTEX_INITIALIZER;
 
+// connections, dns and tls sessions are shared by every handle through http_share
+static CURLSH *http_share = NULL;
+static pthread_mutex_t http_share_locks[CURL_LOCK_DATA_LAST];
+static HandlePool http_pools[HOST_COUNT] = {0};
+static pthread_mutex_t http_pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static EndpointStats endpoint_stats[EP_COUNT] = {0};
+static BodyPool body_pool = { .mutex = PTHREAD_MUTEX_INITIALIZER };
+static const char *endpoint_names[EP_COUNT] = {
+    "me/player", "me/player/*", "me", "me/tracks", "users/*/playlists",
+    "playlists/*/tracks", "token", "images", "other"
+};
+static HttpEngine http_engine = { .mutex = PTHREAD_MUTEX_INITIALIZER };
+static Scheduler scheduler = { .mutex = PTHREAD_MUTEX_INITIALIZER, .cond = PTHREAD_COND_INITIALIZER };
+static RateLimiter rate_limiter = { .tokens = RATE_BUCKET_SIZE, .poll_backoff = 1, .mutex = PTHREAD_MUTEX_INITIALIZER };
+// max concurrent transfers per class, a full thumbnail grid gets 2 sockets at most
+static const int prio_limits[PRIO_COUNT] = { 2, 1, 1, 2, 1 };
+static CommandLane command_lane = { .mutex = PTHREAD_MUTEX_INITIALIZER, .cond = PTHREAD_COND_INITIALIZER };
+static char command_error[128] = {0};
+static uint64_t command_error_time = 0;
+
+static size_t body_class_bytes(int c) {
+    return (size_t)BODY_POOL_MIN_BYTES << (2 * c);
+}
+
+// smallest class that fits bytes, -1 when it is bigger than all of them
+static int body_class_of(size_t bytes) {
+    for (int c = 0; c < BODY_POOL_CLASSES; c++) {
+        if (bytes <= body_class_bytes(c)) {
+            return c;
+        }
+    }
+    return -1;
+}
+
+static char* body_alloc(size_t bytes, size_t *capacity) {
+    int c = body_class_of(bytes);
+    if (c < 0) {
+        pthread_mutex_lock(&body_pool.mutex);
+        body_pool.oversize++;
+        pthread_mutex_unlock(&body_pool.mutex);
+        *capacity = bytes;
+        return malloc(bytes);
+    }
+
+    char *memory = NULL;
+    pthread_mutex_lock(&body_pool.mutex);
+    if (body_pool.count[c] > 0) {
+        memory = body_pool.free[c][--body_pool.count[c]];
+        body_pool.hits++;
+    } else {
+        body_pool.misses++;
+    }
+    pthread_mutex_unlock(&body_pool.mutex);
+
+    *capacity = body_class_bytes(c);
+    return memory ? memory : malloc(*capacity);
+}
+
+static void body_free(char *memory, size_t capacity) {
+    if (!memory) {
+        return;
+    }
+
+    int c = body_class_of(capacity);
+    if (c >= 0 && body_class_bytes(c) == capacity) {
+        pthread_mutex_lock(&body_pool.mutex);
+        if (body_pool.count[c] < BODY_POOL_DEPTH) {
+            body_pool.free[c][body_pool.count[c]++] = memory;
+            memory = NULL;
+        }
+        pthread_mutex_unlock(&body_pool.mutex);
+    }
+    free(memory);
+}
+
+void body_release(MemoryBuffer *mem) {
+    body_free(mem->memory, mem->capacity);
+    mem->memory = NULL;
+    mem->size = 0;
+    mem->capacity = 0;
+}
+
 size_t write_callback(void *content, size_t size, size_t n, void *user) {
     size_t realsize = size * n;
     MemoryBuffer *mem = (MemoryBuffer *)user;
-    char *response = realloc(mem->memory, mem->size + realsize + 1);
-    if (!response) {
-        free(mem->memory);
-        mem->memory = NULL;
-        mem->size = 0;
-        return 0;
+    size_t need = mem->size + realsize + 1;
+
+    if (need > mem->capacity) {
+        size_t want = need;
+        curl_off_t length = -1;
+        bool presized = false;
+        if (!mem->memory && mem->curl &&
+            curl_easy_getinfo(mem->curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &length) == CURLE_OK &&
+            length > 0 && length <= BODY_PRESIZE_MAX && (size_t)length + 1 > want) {
+            // the whole body in one allocation, gzip bodies may still grow past it
+            want = (size_t)length + 1;
+            presized = true;
+        } else if (mem->capacity * 2 > want) {
+            want = mem->capacity * 2;
+        }
+
+        size_t capacity = 0;
+        char *response = body_alloc(want, &capacity);
+        if (!response) {
+            body_release(mem);
+            return 0;
+        }
+        pthread_mutex_lock(&body_pool.mutex);
+        if (mem->memory) {
+            body_pool.grown++;
+        } else if (presized) {
+            body_pool.presized++;
+        }
+        pthread_mutex_unlock(&body_pool.mutex);
+
+        if (mem->memory) {
+            memcpy(response, mem->memory, mem->size);
+            body_free(mem->memory, mem->capacity);
+        }
+        mem->memory = response;
+        mem->capacity = capacity;
     }
-    mem->memory = response;
+
     memcpy(&(mem->memory[mem->size]), content, realsize);
     mem->size += realsize;
     mem->memory[mem->size] = 0;
@@ -193,504 +800,2413 @@ size_t write_callback(void *content, size_t size, size_t n, void *user) {
     return realsize;
 }
 
-void* http_server_thread(void *arg) {
-    AuthData *adata = (AuthData *)arg;
-    int server_fd;
-    int client_fd;
-    struct sockaddr_in addr;
-    int opt = 1;
-    socklen_t addrlen = sizeof(addr);
-    char buffer[2048] = {0};
+uint64_t get_current_time() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
 
-    if ((server_fd = socket(AF_INET, SOCK_STREAM, 0)) == -1) {
-        printf("socket creation failed\n");
-        free(adata);
-        return NULL;
-    }
+    return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
 
-    if (setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt))) {
-        perror("set sock options reuseaddr error");
-        free(adata);
-        close(server_fd);
-        return NULL;
+void publish_player_state(const PlayerSnapshot *snap) {
+    int next = 1 - atomic_load_explicit(&player_state.published, memory_order_relaxed);
+
+    atomic_fetch_add_explicit(&player_state.seq[next], 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    player_state.slots[next] = *snap;
+    atomic_fetch_add_explicit(&player_state.seq[next], 1, memory_order_release);
+
+    atomic_store_explicit(&player_state.published, next, memory_order_release);
+}
+
+// lock free, safe to call every frame from the render loop
+void read_player_state(PlayerSnapshot *out) {
+    for (;;) {
+        int slot = atomic_load_explicit(&player_state.published, memory_order_acquire);
+        unsigned before = atomic_load_explicit(&player_state.seq[slot], memory_order_acquire);
+        if (before & 1) {
+            continue;
+        }
+
+        *out = player_state.slots[slot];
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&player_state.seq[slot], memory_order_relaxed) == before) {
+            return;
+        }
     }
+}
 
-    if (setsockopt(server_fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt))) {
-        perror("set sock options reuseport error");
-        free(adata);
-        close(server_fd);
-        return NULL;
+// ask the poller for a fresh snapshot instead of waiting out the poll interval
+void request_state_refresh() {
+    atomic_store(&state_refresh_requested, true);
+}
+
+void auth_set_token(const char *token) {
+    int next = 1 - atomic_load_explicit(&auth_token.current, memory_order_relaxed);
+
+    atomic_fetch_add_explicit(&auth_token.seq[next], 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    snprintf(auth_token.slots[next], sizeof(auth_token.slots[next]), "%s", token);
+    atomic_fetch_add_explicit(&auth_token.seq[next], 1, memory_order_release);
+
+    atomic_store_explicit(&auth_token.current, next, memory_order_release);
+}
+
+// copies the current access token, never blocks on a refresh in progress
+void auth_get_token(char *out, size_t len) {
+    for (;;) {
+        int slot = atomic_load_explicit(&auth_token.current, memory_order_acquire);
+        unsigned before = atomic_load_explicit(&auth_token.seq[slot], memory_order_acquire);
+        if (before & 1) {
+            continue;
+        }
+
+        snprintf(out, len, "%s", auth_token.slots[slot]);
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&auth_token.seq[slot], memory_order_relaxed) == before) {
+            return;
+        }
     }
+}
 
-    addr.sin_family = AF_INET;
-    addr.sin_addr.s_addr = INADDR_ANY;
-    addr.sin_port = htons(8889);
+// a 401 means the token died early, the refresher renews it right away
+void auth_request_refresh() {
+    atomic_store(&token_refresh_requested, true);
+}
 
-    if (bind(server_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
-        perror("bind failed");
-        free(adata);
-        close(server_fd);
-        return NULL;
+static void http_share_lock(CURL *handle, curl_lock_data data, curl_lock_access access, void *user) {
+    pthread_mutex_lock(&http_share_locks[data]);
+}
+
+static void http_share_unlock(CURL *handle, curl_lock_data data, void *user) {
+    pthread_mutex_unlock(&http_share_locks[data]);
+}
+
+// needs to run before any other thread touches curl
+bool http_init() {
+    if (curl_global_init(CURL_GLOBAL_DEFAULT) != CURLE_OK) {
+        return false;
     }
 
-    if (listen(server_fd, 3) < 0) {
-        perror("listen failed");
-        free(adata);
-        close(server_fd);
-        return NULL;
+    for (int i = 0; i < CURL_LOCK_DATA_LAST; i++) {
+        pthread_mutex_init(&http_share_locks[i], NULL);
     }
 
-    if ((client_fd = accept(server_fd, (struct sockaddr *)&addr, &addrlen)) < 0) {
-        perror("accept failed");
-        free(adata);
-        close(server_fd);
-        return NULL;
+    http_share = curl_share_init();
+    if (!http_share) {
+        return false;
     }
 
-    read(client_fd, buffer, sizeof(buffer) - 1);
+    curl_share_setopt(http_share, CURLSHOPT_LOCKFUNC, http_share_lock);
+    curl_share_setopt(http_share, CURLSHOPT_UNLOCKFUNC, http_share_unlock);
+    curl_share_setopt(http_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+    curl_share_setopt(http_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(http_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
 
-    char *code = NULL;
-    char *state = NULL;
-    char *query = strstr(buffer, "GET /callback?");
-    if (query) {
-        query += strlen("GET /callback?");
-        char *end = strstr(query, " ");
-        if (end) {
-            *end = '\0';
-        }
+    return true;
+}
 
-        char *param = strtok(query, "&");
-        while (param != NULL) {
-            if (strncmp(param, "code=", 5) == 0) {
-                code = param + 5;
-            } else if (strncmp(param, "state=", 6) == 0) {
-                state = param + 6;
+void http_cleanup() {
+    pthread_mutex_lock(&http_pool_mutex);
+    for (int h = 0; h < HOST_COUNT; h++) {
+        for (int i = 0; i < HTTP_POOL_SIZE; i++) {
+            if (http_pools[h].handles[i]) {
+                curl_easy_cleanup(http_pools[h].handles[i]);
+                http_pools[h].handles[i] = NULL;
             }
-
-            param = strtok(NULL, "&");
         }
     }
+    pthread_mutex_unlock(&http_pool_mutex);
 
-    if (code == NULL || state == NULL || strcmp(state, adata->state) != 0) {
-        fprintf(stderr, "code or state is null\n");
-        goto cleanup;
+    if (http_share) {
+        curl_share_cleanup(http_share);
+        http_share = NULL;
     }
+    curl_global_cleanup();
+}
 
-    CURL *curl = curl_easy_init();
-    if (curl) {
-        MemoryBuffer response = {
-            malloc(1),
-            0
-        };
-        if (!response.memory) {
-            return NULL;
-        }
-
-        char pdata[1024];
-        snprintf(pdata, sizeof(pdata),
-            "grant_type=authorization_code&"
-            "code=%s&"
-            "redirect_uri=%s&"
-            "client_id=%s&"
-            "client_secret=%s",
-            code, adata->redirect_uri, adata->client_id, adata->client_secret);
-             
-        struct curl_slist *headers = NULL;
-        headers = curl_slist_append(headers, "Content-Type: application/x-www-form-urlencoded");
-
-        curl_easy_setopt(curl, CURLOPT_URL, "https://accounts.spotify.com/api/token");
-        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, pdata);
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)&response);
-        
-        CURLcode res = curl_easy_perform(curl);
-        if (res == CURLM_OK && response.size != 0) {
-            cJSON *json = cJSON_Parse(response.memory);
-            if (json) {
-                cJSON *access_token_json = cJSON_GetObjectItemCaseSensitive(json, "access_token");
-                cJSON *refresh_token_json = cJSON_GetObjectItemCaseSensitive(json, "refresh_token");
-                cJSON *expires_in_json = cJSON_GetObjectItemCaseSensitive(json, "expires_in");
-
-                if (cJSON_IsString(access_token_json) && cJSON_IsString(refresh_token_json) &&
-                    cJSON_IsNumber(expires_in_json)) {
-                    pthread_mutex_lock(&spclient_mutex);
-                    strncpy(spclient.access_token, access_token_json->valuestring, sizeof(spclient.access_token) - 1);
-                    spclient.access_token[sizeof(spclient.access_token) - 1] = '\0';
-                    strncpy(spclient.refresh_token, refresh_token_json->valuestring, sizeof(spclient.refresh_token) - 1);
-                    spclient.refresh_token[sizeof(spclient.refresh_token) - 1] = '\0';
-                    spclient.expiry = expires_in_json->valueint;
-                    strncpy(spclient.client_id, adata->client_id, sizeof(spclient.client_id) - 1);
-                    spclient.client_id[sizeof(spclient.client_id) - 1] = '\0';
-                    strncpy(spclient.client_secret, adata->client_secret, sizeof(spclient.client_secret) - 1);
-                    spclient.client_secret[sizeof(spclient.client_secret) - 1] = '\0';
-                    pthread_mutex_unlock(&spclient_mutex);
+static bool host_matches(const char *host, size_t len, const char *suffix) {
+    size_t slen = strlen(suffix);
+    return len >= slen && strncmp(host + len - slen, suffix, slen) == 0;
+}
 
-                    pthread_mutex_lock(&logged_in_mutex);
-                    logged_in = true;
-                    pthread_mutex_unlock(&logged_in_mutex);
-                }
-                cJSON_Delete(json);
-            }
-        }
+HttpHost http_host_of(const char *url) {
+    const char *host = strstr(url, "://");
+    host = host ? host + 3 : url;
+    size_t len = strcspn(host, "/:?");
+
+    if (host_matches(host, len, "api.spotify.com")) {
+        return HOST_API;
+    } else if (host_matches(host, len, "accounts.spotify.com")) {
+        return HOST_ACCOUNTS;
+    } else if (host_matches(host, len, "scdn.co") || host_matches(host, len, "spotifycdn.com")) {
+        return HOST_IMAGES;
+    }
+
+    return HOST_OTHER;
+}
+
+// options every request gets, reapplied after each curl_easy_reset
+static void http_prepare(CURL *curl) {
+    curl_easy_setopt(curl, CURLOPT_SHARE, http_share);
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPIDLE, 30L);
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPINTVL, 15L);
+    curl_easy_setopt(curl, CURLOPT_DNS_CACHE_TIMEOUT, 600L);
+    // empty string offers every encoding this libcurl can decode
+    curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, "");
+}
+
+static bool path_is(const char *path, const char *prefix) {
+    size_t len = strlen(prefix);
+    return strncmp(path, prefix, len) == 0 && (path[len] == '\0' || path[len] == '?');
+}
 
-        curl_slist_free_all(headers);
-        curl_easy_cleanup(curl);
+ApiEndpoint endpoint_of(const char *url) {
+    HttpHost host = http_host_of(url);
+    if (host == HOST_ACCOUNTS) {
+        return EP_TOKEN;
+    } else if (host == HOST_IMAGES) {
+        return EP_IMAGES;
+    } else if (host != HOST_API) {
+        return EP_OTHER;
     }
 
-    cleanup:
-        char *http_response = "HTTP/1.1 200 OK\r\nContent-Type: text/html\r\n\r\n<html><body>Login successful! You can close this window.</body></html>";
-        send(client_fd, http_response, strlen(http_response), 0);
-        close(client_fd);
-        close(server_fd);
-        free(adata);
-        return NULL;
+    const char *path = strstr(url, "/v1/");
+    if (!path) {
+        return EP_OTHER;
+    }
+
+    if (path_is(path, "/v1/me/player")) {
+        return EP_PLAYER_STATE;
+    } else if (strncmp(path, "/v1/me/player/", 14) == 0) {
+        return EP_PLAYER_COMMAND;
+    } else if (path_is(path, "/v1/me/tracks")) {
+        return EP_LIBRARY;
+    } else if (path_is(path, "/v1/me")) {
+        return EP_ME;
+    } else if (strncmp(path, "/v1/users/", 10) == 0 && strstr(path, "/playlists")) {
+        return EP_PLAYLISTS;
+    } else if (strncmp(path, "/v1/playlists/", 14) == 0 && strstr(path, "/tracks")) {
+        return EP_PLAYLIST_TRACKS;
+    }
+
+    return EP_OTHER;
 }
 
-bool spotify_request(const char *endpoint_base, const char *access_token, const char *payload) {
-    char endpoint[512];
-    pthread_mutex_lock(&spclient_mutex);
-    if (strlen(spclient.current_playing_id) > 0) {
-        snprintf(endpoint, sizeof(endpoint), "%s?device_id=%s", endpoint_base, spclient.current_playing_id);
-    } else {
-        strncpy(endpoint, endpoint_base, sizeof(endpoint) - 1);
-        endpoint[sizeof(endpoint) - 1] = '\0';
+// counts body bytes as they came over the wire, so compression shows up too
+void http_account(CURL *curl) {
+    char *url = NULL;
+    curl_off_t bytes = 0;
+    if (curl_easy_getinfo(curl, CURLINFO_EFFECTIVE_URL, &url) != CURLE_OK || !url) {
+        return;
     }
-    pthread_mutex_unlock(&spclient_mutex);
+    curl_easy_getinfo(curl, CURLINFO_SIZE_DOWNLOAD_T, &bytes);
 
-    CURL *curl = curl_easy_init();
-    if (!curl) {
-        return false;
+    ApiEndpoint ep = endpoint_of(url);
+    atomic_fetch_add(&endpoint_stats[ep].bytes, (unsigned long long)bytes);
+    atomic_fetch_add(&endpoint_stats[ep].requests, 1);
+}
+
+void http_print_stats() {
+    printf("%-20s %10s %12s %10s\n", "endpoint", "requests", "bytes", "avg");
+    for (int i = 0; i < EP_COUNT; i++) {
+        unsigned requests = atomic_load(&endpoint_stats[i].requests);
+        unsigned long long bytes = atomic_load(&endpoint_stats[i].bytes);
+        if (requests == 0) {
+            continue;
+        }
+        printf("%-20s %10u %12llu %10llu\n", endpoint_names[i], requests, bytes, bytes / requests);
     }
 
-    struct curl_slist *headers = NULL;
-    char auth_header[256];
-    snprintf(auth_header, sizeof(auth_header), "Authorization: Bearer %s", access_token);
-    headers = curl_slist_append(headers, auth_header);
-    headers = curl_slist_append(headers, "Content-Type: application/json");
+    pthread_mutex_lock(&body_pool.mutex);
+    printf("Body pool: %u hits, %u misses, %u oversize, %u presized from Content-Length, %u grown\n",
+        body_pool.hits, body_pool.misses, body_pool.oversize, body_pool.presized, body_pool.grown);
+    pthread_mutex_unlock(&body_pool.mutex);
+}
+
+// hands out a warm handle for the host of url, release it with http_release()
+CURL* http_acquire(const char *url) {
+    HandlePool *pool = &http_pools[http_host_of(url)];
+    CURL *curl = NULL;
+
+    pthread_mutex_lock(&http_pool_mutex);
+    for (int i = 0; i < HTTP_POOL_SIZE; i++) {
+        if (pool->in_use[i]) {
+            continue;
+        }
+
+        if (!pool->handles[i]) {
+            pool->handles[i] = curl_easy_init();
+            if (!pool->handles[i]) {
+                break;
+            }
+        }
+        pool->in_use[i] = true;
+        curl = pool->handles[i];
+        break;
+    }
+    pthread_mutex_unlock(&http_pool_mutex);
+
+    // pool exhausted, the shared connection cache still keeps this one warm
+    if (!curl) {
+        curl = curl_easy_init();
+    }
+
+    if (curl) {
+        http_prepare(curl);
+    }
+    return curl;
+}
+
+void http_release(CURL *curl) {
+    if (!curl) {
+        return;
+    }
+
+    // reset drops per-request options but keeps the handle's live connections
+    curl_easy_reset(curl);
+
+    pthread_mutex_lock(&http_pool_mutex);
+    for (int h = 0; h < HOST_COUNT; h++) {
+        for (int i = 0; i < HTTP_POOL_SIZE; i++) {
+            if (http_pools[h].handles[i] == curl) {
+                http_pools[h].in_use[i] = false;
+                pthread_mutex_unlock(&http_pool_mutex);
+                return;
+            }
+        }
+    }
+    pthread_mutex_unlock(&http_pool_mutex);
+
+    curl_easy_cleanup(curl);
+}
+
+// caller holds scheduler.mutex
+static bool sched_can_start(RequestPriority prio) {
+    if (scheduler.active[prio] >= prio_limits[prio]) {
+        return false;
+    }
+
+    for (int p = 0; p < (int)prio; p++) {
+        if (scheduler.waiting[p] > 0) {
+            return false;
+        }
+    }
+
+    // while a control is on the wire only state polling may start alongside it
+    return prio <= PRIO_STATE || scheduler.active[PRIO_INTERACTIVE] == 0;
+}
+
+// blocks until a transfer of this class may start, pair with sched_release()
+void sched_acquire(RequestPriority prio) {
+    pthread_mutex_lock(&scheduler.mutex);
+    scheduler.waiting[prio]++;
+    while (!sched_can_start(prio)) {
+        pthread_cond_wait(&scheduler.cond, &scheduler.mutex);
+    }
+    scheduler.waiting[prio]--;
+    scheduler.active[prio]++;
+    pthread_mutex_unlock(&scheduler.mutex);
+}
+
+// non blocking variant for the engine, queued says the
+// caller was counted in waiting through sched_note_waiting()
+bool sched_try_acquire(RequestPriority prio, bool queued) {
+    pthread_mutex_lock(&scheduler.mutex);
+    bool ok = sched_can_start(prio);
+    if (ok) {
+        if (queued) {
+            scheduler.waiting[prio]--;
+        }
+        scheduler.active[prio]++;
+    }
+    pthread_mutex_unlock(&scheduler.mutex);
+
+    return ok;
+}
+
+// lets requests parked in the engine hold back lower classes like blocking waiters do
+void sched_note_waiting(RequestPriority prio, int delta) {
+    pthread_mutex_lock(&scheduler.mutex);
+    scheduler.waiting[prio] += delta;
+    pthread_mutex_unlock(&scheduler.mutex);
+}
+
+void sched_release(RequestPriority prio) {
+    pthread_mutex_lock(&scheduler.mutex);
+    scheduler.active[prio]--;
+    pthread_cond_broadcast(&scheduler.cond);
+    pthread_mutex_unlock(&scheduler.mutex);
+
+    // the engine may have requests parked behind this one
+    if (http_engine.multi) {
+        curl_multi_wakeup(http_engine.multi);
+    }
+}
+
+// caller holds rate_limiter.mutex, returns ms until a token of this class is available
+static uint64_t rate_wait_ms(RequestPriority prio) {
+    uint64_t now = get_current_time();
+    if (rate_limiter.last_refill) {
+        rate_limiter.tokens += (now - rate_limiter.last_refill) * RATE_REFILL_PER_SEC / 1000.0;
+        if (rate_limiter.tokens > RATE_BUCKET_SIZE) {
+            rate_limiter.tokens = RATE_BUCKET_SIZE;
+        }
+    }
+    rate_limiter.last_refill = now;
+
+    if (now < rate_limiter.blocked_until) {
+        return rate_limiter.blocked_until - now;
+    }
+
+    double floor = (prio == PRIO_INTERACTIVE) ? 0 : RATE_INTERACTIVE_RESERVE;
+    if (rate_limiter.tokens - 1 >= floor) {
+        return 0;
+    }
+
+    return (uint64_t)((floor + 1 - rate_limiter.tokens) * 1000 / RATE_REFILL_PER_SEC) + 1;
+}
+
+// takes a token without waiting, for the engine and the render thread
+bool rate_try(RequestPriority prio) {
+    pthread_mutex_lock(&rate_limiter.mutex);
+    bool ok = rate_wait_ms(prio) == 0;
+    if (ok) {
+        rate_limiter.tokens -= 1;
+    }
+    pthread_mutex_unlock(&rate_limiter.mutex);
+
+    return ok;
+}
+
+// hands back a token taken by rate_try() for a request that didn't go out
+void rate_refund() {
+    pthread_mutex_lock(&rate_limiter.mutex);
+    if (rate_limiter.tokens + 1 <= RATE_BUCKET_SIZE) {
+        rate_limiter.tokens += 1;
+    }
+    pthread_mutex_unlock(&rate_limiter.mutex);
+}
+
+// blocks until a token of this class is available, call before sched_acquire()
+void rate_wait(RequestPriority prio) {
+    while (running) {
+        pthread_mutex_lock(&rate_limiter.mutex);
+        uint64_t wait = rate_wait_ms(prio);
+        if (wait == 0) {
+            rate_limiter.tokens -= 1;
+        }
+        pthread_mutex_unlock(&rate_limiter.mutex);
+
+        if (wait == 0) {
+            return;
+        }
+        usleep((wait < 100 ? wait : 100) * 1000);
+    }
+}
+
+// feeds every api response back into the limiter
+void rate_observe(CURL *curl, long status) {
+    pthread_mutex_lock(&rate_limiter.mutex);
+    if (status == 429) {
+        curl_off_t retry_after = 0;
+        if (curl_easy_getinfo(curl, CURLINFO_RETRY_AFTER, &retry_after) != CURLE_OK || retry_after <= 0) {
+            retry_after = RATE_DEFAULT_RETRY_S;
+        }
+
+        rate_limiter.blocked_until = get_current_time() + (uint64_t)retry_after * 1000;
+        rate_limiter.tokens = 0;
+        if (rate_limiter.poll_backoff < RATE_MAX_POLL_BACKOFF) {
+            rate_limiter.poll_backoff *= 2;
+        }
+        rate_limiter.throttled++;
+        fprintf(stderr, "Rate limited by Spotify, backing off %lds (poll x%d)\n",
+            (long)retry_after, rate_limiter.poll_backoff);
+    } else if (status >= 200 && status < 300 && rate_limiter.poll_backoff > 1) {
+        rate_limiter.poll_backoff--;
+    }
+    pthread_mutex_unlock(&rate_limiter.mutex);
+}
+
+bool rate_limited() {
+    pthread_mutex_lock(&rate_limiter.mutex);
+    bool limited = get_current_time() < rate_limiter.blocked_until;
+    pthread_mutex_unlock(&rate_limiter.mutex);
+
+    return limited;
+}
+
+// every api.spotify.com response goes through here
+void api_observe(CURL *curl, long status) {
+    rate_observe(curl, status);
+    if (status == 401) {
+        auth_request_refresh();
+    }
+}
+
+// polling is the first thing to give way when the budget runs low
+uint64_t rate_poll_interval() {
+    pthread_mutex_lock(&rate_limiter.mutex);
+    uint64_t interval = (uint64_t)STATE_POLL_MS * rate_limiter.poll_backoff;
+    if (rate_limiter.tokens < RATE_INTERACTIVE_RESERVE * 2) {
+        interval *= 2;
+    }
+    pthread_mutex_unlock(&rate_limiter.mutex);
+
+    return interval;
+}
+
+HttpRequest* http_request_new(RequestPriority priority, const char *method, const char *url, const char *payload) {
+    HttpRequest *req = calloc(1, sizeof(HttpRequest));
+    if (!req) {
+        return NULL;
+    }
+
+    req->priority = priority;
+    req->method = method;
+    snprintf(req->url, sizeof(req->url), "%s", url);
+    if (payload) {
+        req->payload = strdup(payload);
+    }
+
+    return req;
+}
+
+void http_request_free(HttpRequest *req) {
+    if (!req) {
+        return;
+    }
+
+    if (req->curl) {
+        http_release(req->curl);
+    }
+    curl_slist_free_all(req->headers);
+    free(req->payload);
+    body_release(&req->response);
+    free(req);
+}
+
+// fields the api sends on tracks and albums that nothing here reads, available_markets alone is
+// ~180 strings per object, so they are skipped by the parser instead of built and thrown away
+static const char *response_skip_keys[] = { "available_markets", "external_ids", "external_urls", NULL };
+
+// parses the body of a finished request, NULL on transport, json or api errors
+cJSON* http_response_json(HttpRequest *req) {
+    if (req->result != CURLE_OK || !req->response.memory) {
+        fprintf(stderr, "CURL error for %s: %s\n", req->url, curl_easy_strerror(req->result));
+        return NULL;
+    }
+
+    // responses are only read, so the whole tree goes in one arena and is freed in one go
+    cJSON *json = cJSON_ParseWithSkipKeys(req->response.memory, req->response.size, response_skip_keys, true);
+    if (!json) {
+        fprintf(stderr, "JSON parse error for %s: %s\n", req->url, cJSON_GetErrorPtr());
+        return NULL;
+    }
+
+    cJSON *error = cJSON_GetObjectItemCaseSensitive(json, "error");
+    if (error) {
+        fprintf(stderr, "Spotify API error for %s: %s\n", req->url,
+            cJSON_GetStringValue(cJSON_GetObjectItemCaseSensitive(error, "message")));
+        cJSON_Delete(json);
+        return NULL;
+    }
+
+    return json;
+}
+
+static void http_engine_complete(HttpRequest *req) {
+    req->next = NULL;
+    pthread_mutex_lock(&http_engine.mutex);
+    if (http_engine.completed_tail) {
+        http_engine.completed_tail->next = req;
+    } else {
+        http_engine.completed = req;
+    }
+    http_engine.completed_tail = req;
+    pthread_mutex_unlock(&http_engine.mutex);
+}
+
+static bool http_engine_add(HttpRequest *req) {
+    req->curl = http_acquire(req->url);
+    if (!req->curl) {
+        return false;
+    }
+
+    // token is read at admission so parked requests pick up a refreshed one
+    if (http_host_of(req->url) == HOST_API) {
+        char token[256];
+        char auth_header[300];
+        auth_get_token(token, sizeof(token));
+        snprintf(auth_header, sizeof(auth_header), "Authorization: Bearer %s", token);
+        req->headers = curl_slist_append(req->headers, auth_header);
+    }
+    req->headers = curl_slist_append(req->headers, "Content-Type: application/json");
+
+    curl_easy_setopt(req->curl, CURLOPT_URL, req->url);
+    curl_easy_setopt(req->curl, CURLOPT_HTTPHEADER, req->headers);
+    curl_easy_setopt(req->curl, CURLOPT_WRITEFUNCTION, write_callback);
+    req->response.curl = req->curl;
+    curl_easy_setopt(req->curl, CURLOPT_WRITEDATA, (void *)&req->response);
+    curl_easy_setopt(req->curl, CURLOPT_PRIVATE, (void *)req);
+
+    if (strcmp(req->method, "POST") == 0) {
+        curl_easy_setopt(req->curl, CURLOPT_POST, 1L);
+        curl_easy_setopt(req->curl, CURLOPT_POSTFIELDS, req->payload ? req->payload : "");
+    } else if (strcmp(req->method, "GET") != 0) {
+        curl_easy_setopt(req->curl, CURLOPT_CUSTOMREQUEST, req->method);
+        if (req->payload) {
+            curl_easy_setopt(req->curl, CURLOPT_POSTFIELDS, req->payload);
+        }
+    }
+
+    if (curl_multi_add_handle(http_engine.multi, req->curl) != CURLM_OK) {
+        return false;
+    }
+
+    req->next = http_engine.active;
+    http_engine.active = req;
+    return true;
+}
+
+static void http_engine_unlink_active(HttpRequest *req) {
+    HttpRequest **link = &http_engine.active;
+    while (*link && *link != req) {
+        link = &(*link)->next;
+    }
+    if (*link) {
+        *link = req->next;
+    }
+}
+
+void* http_engine_thread(void *arg) {
+    while (running) {
+        // admit parked requests highest class first, as far as the scheduler allows
+        HttpRequest *admitted = NULL;
+        bool parked = false;
+        pthread_mutex_lock(&http_engine.mutex);
+        for (int p = 0; p < PRIO_COUNT; p++) {
+            while (http_engine.pending[p]) {
+                bool api = http_host_of(http_engine.pending[p]->url) == HOST_API;
+                if (api && !rate_try(p)) {
+                    break;
+                }
+                if (!sched_try_acquire(p, true)) {
+                    if (api) {
+                        rate_refund();
+                    }
+                    break;
+                }
+
+                HttpRequest *req = http_engine.pending[p];
+                http_engine.pending[p] = req->next;
+                if (!http_engine.pending[p]) {
+                    http_engine.pending_tail[p] = NULL;
+                }
+                req->next = admitted;
+                admitted = req;
+            }
+            parked = parked || http_engine.pending[p];
+        }
+        pthread_mutex_unlock(&http_engine.mutex);
+
+        while (admitted) {
+            HttpRequest *req = admitted;
+            admitted = admitted->next;
+            if (!http_engine_add(req)) {
+                sched_release(req->priority);
+                req->result = CURLE_FAILED_INIT;
+                http_engine_complete(req);
+            }
+        }
+
+        int still_running = 0;
+        curl_multi_perform(http_engine.multi, &still_running);
+
+        CURLMsg *msg;
+        int msgs_left = 0;
+        while ((msg = curl_multi_info_read(http_engine.multi, &msgs_left))) {
+            if (msg->msg != CURLMSG_DONE) {
+                continue;
+            }
+
+            HttpRequest *req = NULL;
+            curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char **)&req);
+            req->result = msg->data.result;
+            curl_easy_getinfo(req->curl, CURLINFO_RESPONSE_CODE, &req->status);
+            http_account(req->curl);
+            if (http_host_of(req->url) == HOST_API) {
+                api_observe(req->curl, req->status);
+            }
+
+            http_engine_unlink_active(req);
+            sched_release(req->priority);
+            curl_multi_remove_handle(http_engine.multi, req->curl);
+            http_release(req->curl);
+            req->curl = NULL;
+            curl_slist_free_all(req->headers);
+            req->headers = NULL;
+
+            http_engine_complete(req);
+        }
+
+        // sleeps until a socket is ready or http_submit() wakes us up,
+        // parked requests may be waiting on rate tokens so check back sooner
+        curl_multi_poll(http_engine.multi, NULL, 0, parked ? 100 : 1000, NULL);
+    }
+
+    return NULL;
+}
+
+bool http_engine_start() {
+    http_engine.multi = curl_multi_init();
+    if (!http_engine.multi) {
+        return false;
+    }
+
+    if (pthread_create(&http_engine.thread, NULL, http_engine_thread, NULL) != 0) {
+        curl_multi_cleanup(http_engine.multi);
+        http_engine.multi = NULL;
+        return false;
+    }
+
+    return true;
+}
+
+// running must already be cleared
+void http_engine_stop() {
+    if (!http_engine.multi) {
+        return;
+    }
+
+    curl_multi_wakeup(http_engine.multi);
+    pthread_join(http_engine.thread, NULL);
+
+    // whatever is still attached to the multi handle is abandoned
+    for (HttpRequest *req = http_engine.active; req; req = req->next) {
+        curl_multi_remove_handle(http_engine.multi, req->curl);
+    }
+
+    HttpRequest *lists[PRIO_COUNT + 2] = { http_engine.active, http_engine.completed };
+    for (int p = 0; p < PRIO_COUNT; p++) {
+        lists[p + 2] = http_engine.pending[p];
+        http_engine.pending[p] = http_engine.pending_tail[p] = NULL;
+    }
+    for (int i = 0; i < PRIO_COUNT + 2; i++) {
+        while (lists[i]) {
+            HttpRequest *next = lists[i]->next;
+            http_request_free(lists[i]);
+            lists[i] = next;
+        }
+    }
+    http_engine.active = NULL;
+    http_engine.completed = http_engine.completed_tail = NULL;
+
+    curl_multi_cleanup(http_engine.multi);
+    http_engine.multi = NULL;
+}
+
+// thread safe, takes ownership of req
+bool http_submit(HttpRequest *req) {
+    if (!req) {
+        return false;
+    }
+
+    RequestPriority prio = req->priority;
+    req->next = NULL;
+    sched_note_waiting(prio, 1);
+
+    pthread_mutex_lock(&http_engine.mutex);
+    if (http_engine.pending_tail[prio]) {
+        http_engine.pending_tail[prio]->next = req;
+    } else {
+        http_engine.pending[prio] = req;
+    }
+    http_engine.pending_tail[prio] = req;
+    pthread_mutex_unlock(&http_engine.mutex);
+
+    curl_multi_wakeup(http_engine.multi);
+    return true;
+}
+
+// called once per frame from main(), completion callbacks run here
+void http_drain_completions() {
+    pthread_mutex_lock(&http_engine.mutex);
+    HttpRequest *done = http_engine.completed;
+    http_engine.completed = NULL;
+    http_engine.completed_tail = NULL;
+    pthread_mutex_unlock(&http_engine.mutex);
+
+    while (done) {
+        HttpRequest *next = done->next;
+        if (done->on_complete) {
+            done->on_complete(done);
+        }
+        http_request_free(done);
+        done = next;
+    }
+}
+
+static size_t discard_callback(void *content, size_t size, size_t n, void *user) {
+    return size * n;
+}
+
+// caller holds command_lane.mutex
+static void command_push_done(const PlayerCommand *cmd) {
+    // oldest unread result is overwritten if the ui falls behind
+    if (command_lane.done_count == COMMAND_QUEUE_SIZE) {
+        command_lane.done_head = (command_lane.done_head + 1) % COMMAND_QUEUE_SIZE;
+        command_lane.done_count--;
+    }
+    command_lane.done[(command_lane.done_head + command_lane.done_count) % COMMAND_QUEUE_SIZE] = *cmd;
+    command_lane.done_count++;
+}
+
+static PlayerCommand* command_at(int pos) {
+    return &command_lane.queue[(command_lane.head + pos) % COMMAND_QUEUE_SIZE];
+}
+
+// drops the queued command at pos and reports it as cancelled, caller holds the mutex
+static void command_cancel_at(int pos) {
+    PlayerCommand *cmd = command_at(pos);
+    cmd->status = CMD_STATUS_CANCELLED;
+    command_push_done(cmd);
+
+    for (int i = pos; i < command_lane.count - 1; i++) {
+        *command_at(i) = *command_at(i + 1);
+    }
+    command_lane.count--;
+    command_lane.coalesced++;
+}
+
+static bool command_is_toggle(CommandType type, const char *arg) {
+    return (type == CMD_PLAY && (!arg || !arg[0])) || type == CMD_PAUSE;
+}
+
+// collapses the incoming command against what is still queued or in flight,
+// returns true if it was absorbed and must not be queued, caller holds the mutex
+static bool command_coalesce(const PlayerCommand *incoming) {
+    CommandType type = incoming->type;
+
+    switch (type) {
+        case CMD_VOLUME:
+        case CMD_SHUFFLE:
+            // absolute targets, only the newest one matters. one already in flight is left
+            // to finish, aborting it would drop the warm connection and spotify may have
+            // applied it anyway, the incoming one goes out right after and wins
+            for (int i = command_lane.count - 1; i >= 0; i--) {
+                if (command_at(i)->type == type) {
+                    command_cancel_at(i);
+                }
+            }
+            return false;
+
+        case CMD_PLAY:
+        case CMD_PAUSE:
+            if (!command_is_toggle(type, incoming->arg)) {
+                return false;
+            }
+            for (int i = command_lane.count - 1; i >= 0; i--) {
+                PlayerCommand *queued = command_at(i);
+                if (!command_is_toggle(queued->type, queued->arg)) {
+                    continue;
+                }
+
+                // pause then play (or the reverse) is a no-op, a repeat is redundant
+                if (queued->type != type) {
+                    command_cancel_at(i);
+                }
+                return true;
+            }
+            return false;
+
+        // skips are never coalesced, each next moves on another track and
+        // previous restarts the current one once it is a few seconds in, so
+        // next then previous doesn't cancel out
+        default:
+            return false;
+    }
+}
+
+// thread safe, used by both the gpio callbacks and the touch controls
+uint32_t command_enqueue(CommandType type, int value, const char *arg) {
+    PlayerCommand incoming = {0};
+    incoming.type = type;
+    incoming.value = value;
+    if (arg) {
+        snprintf(incoming.arg, sizeof(incoming.arg), "%s", arg);
+    }
+    incoming.status = CMD_STATUS_QUEUED;
+
+    pthread_mutex_lock(&command_lane.mutex);
+    incoming.id = ++command_lane.next_id;
+
+    if (command_coalesce(&incoming)) {
+        incoming.status = CMD_STATUS_CANCELLED;
+        command_push_done(&incoming);
+        command_lane.coalesced++;
+        pthread_mutex_unlock(&command_lane.mutex);
+        return incoming.id;
+    }
+
+    if (command_lane.count == COMMAND_QUEUE_SIZE) {
+        pthread_mutex_unlock(&command_lane.mutex);
+        fprintf(stderr, "Command queue full, dropping command %d\n", type);
+        return 0;
+    }
+
+    *command_at(command_lane.count) = incoming;
+    command_lane.count++;
+
+    pthread_cond_signal(&command_lane.cond);
+    pthread_mutex_unlock(&command_lane.mutex);
+
+    return incoming.id;
+}
+
+static void command_build(const PlayerCommand *cmd, char *url, size_t url_len, const char **method,
+    char *payload, size_t payload_len) {
+    const char *base = NULL;
+    bool player = true;
+    char query[300] = {0};
+    payload[0] = '\0';
+
+    switch (cmd->type) {
+        case CMD_PLAY:
+            *method = "PUT";
+            base = "https://api.spotify.com/v1/me/player/play";
+            if (cmd->arg[0]) {
+                snprintf(payload, payload_len, "{\"uris\":[\"%s\"]}", cmd->arg);
+            }
+            break;
+        case CMD_PAUSE:
+            *method = "PUT";
+            base = "https://api.spotify.com/v1/me/player/pause";
+            break;
+        case CMD_NEXT:
+            *method = "POST";
+            base = "https://api.spotify.com/v1/me/player/next";
+            break;
+        case CMD_PREVIOUS:
+            *method = "POST";
+            base = "https://api.spotify.com/v1/me/player/previous";
+            break;
+        case CMD_SHUFFLE:
+            *method = "PUT";
+            base = "https://api.spotify.com/v1/me/player/shuffle";
+            snprintf(query, sizeof(query), "state=%s", cmd->value ? "true" : "false");
+            break;
+        case CMD_VOLUME:
+            *method = "PUT";
+            base = "https://api.spotify.com/v1/me/player/volume";
+            snprintf(query, sizeof(query), "volume_percent=%d", cmd->value);
+            break;
+        case CMD_LIKE:
+            *method = "PUT";
+            base = "https://api.spotify.com/v1/me/tracks";
+            snprintf(query, sizeof(query), "ids=%s", cmd->arg);
+            player = false;
+            break;
+    }
+
+    pthread_mutex_lock(&spclient_mutex);
+    if (player && spclient.current_playing_id[0]) {
+        size_t used = strlen(query);
+        snprintf(query + used, sizeof(query) - used, "%sdevice_id=%s", used ? "&" : "",
+            spclient.current_playing_id);
+    }
+    pthread_mutex_unlock(&spclient_mutex);
+
+    snprintf(url, url_len, "%s%s%s", base, query[0] ? "?" : "", query);
+}
+
+static void command_perform(CURL *curl, PlayerCommand *cmd) {
+    char url[512];
+    char payload[512];
+    const char *method = "PUT";
+    command_build(cmd, url, sizeof(url), &method, payload, sizeof(payload));
+
+    char token[256];
+    char auth_header[300];
+    auth_get_token(token, sizeof(token));
+    snprintf(auth_header, sizeof(auth_header), "Authorization: Bearer %s", token);
+
+    struct curl_slist *headers = NULL;
+    headers = curl_slist_append(headers, auth_header);
+    headers = curl_slist_append(headers, "Content-Type: application/json");
+
+    curl_easy_setopt(curl, CURLOPT_URL, url);
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, discard_callback);
+    if (strcmp(method, "POST") == 0) {
+        curl_easy_setopt(curl, CURLOPT_POST, 1L);
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, payload);
+    } else {
+        curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, method);
+        if (payload[0]) {
+            curl_easy_setopt(curl, CURLOPT_POSTFIELDS, payload);
+        }
+    }
+
+    rate_wait(PRIO_INTERACTIVE);
+    sched_acquire(PRIO_INTERACTIVE);
+    CURLcode res = curl_easy_perform(curl);
+    sched_release(PRIO_INTERACTIVE);
+    cmd->http_status = 0;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &cmd->http_status);
+    api_observe(curl, cmd->http_status);
+    http_account(curl);
+    cmd->status = (res == CURLE_OK && cmd->http_status >= 200 && cmd->http_status < 300) ?
+        CMD_STATUS_OK : CMD_STATUS_FAILED;
+
+    curl_slist_free_all(headers);
+    // back to defaults but the connection to api.spotify.com stays open
+    curl_easy_reset(curl);
+    http_prepare(curl);
+}
+
+void* command_worker_thread(void *arg) {
+    // pinned for the lifetime of the worker so commands always go out warm
+    CURL *curl = http_acquire("https://api.spotify.com/v1/me/player");
+    if (!curl) {
+        fprintf(stderr, "Command worker failed to get a curl handle\n");
+        return NULL;
+    }
+
+    pthread_mutex_lock(&command_lane.mutex);
+    while (running) {
+        if (command_lane.count == 0) {
+            pthread_cond_wait(&command_lane.cond, &command_lane.mutex);
+            continue;
+        }
+
+        PlayerCommand cmd = command_lane.queue[command_lane.head];
+        command_lane.head = (command_lane.head + 1) % COMMAND_QUEUE_SIZE;
+        command_lane.count--;
+        pthread_mutex_unlock(&command_lane.mutex);
+
+        command_perform(curl, &cmd);
+
+        pthread_mutex_lock(&command_lane.mutex);
+        command_push_done(&cmd);
+    }
+    pthread_mutex_unlock(&command_lane.mutex);
+
+    http_release(curl);
+    return NULL;
+}
+
+bool command_lane_start() {
+    return pthread_create(&command_lane.thread, NULL, command_worker_thread, NULL) == 0;
+}
+
+// running must already be cleared
+void command_lane_stop() {
+    pthread_mutex_lock(&command_lane.mutex);
+    pthread_cond_broadcast(&command_lane.cond);
+    pthread_mutex_unlock(&command_lane.mutex);
+    pthread_join(command_lane.thread, NULL);
+
+    printf("Command lane: %u commands sent or queued, %u coalesced away\n",
+        command_lane.next_id, command_lane.coalesced);
+}
+
+// called once per frame from main(), reports how each command went
+void command_drain_results() {
+    PlayerCommand done[COMMAND_QUEUE_SIZE];
+    int count = 0;
+
+    pthread_mutex_lock(&command_lane.mutex);
+    while (command_lane.done_count > 0) {
+        done[count++] = command_lane.done[command_lane.done_head];
+        command_lane.done_head = (command_lane.done_head + 1) % COMMAND_QUEUE_SIZE;
+        command_lane.done_count--;
+    }
+    pthread_mutex_unlock(&command_lane.mutex);
+
+    for (int i = 0; i < count; i++) {
+        // cancelled commands were superseded by a newer press, nothing to report
+        if (done[i].status == CMD_STATUS_FAILED) {
+            fprintf(stderr, "Command %u (type %d) failed, HTTP %ld\n", done[i].id, done[i].type, done[i].http_status);
+            snprintf(command_error, sizeof(command_error), "Spotify rejected that (HTTP %ld)", done[i].http_status);
+            command_error_time = get_current_time();
+        }
+    }
+
+    // failed or not, the real player state is what the ui should show next
+    if (count > 0) {
+        request_state_refresh();
+    }
+}
+
+// posts a form to the token endpoint and installs whatever tokens come back,
+// used for both the login code exchange and refreshes
+bool token_request(const char *form) {
+    CURL *curl = http_acquire("https://accounts.spotify.com/api/token");
+    if (!curl) {
+        return false;
+    }
+
+    MemoryBuffer response = { .curl = curl };
+    struct curl_slist *headers = NULL;
+    headers = curl_slist_append(headers, "Content-Type: application/x-www-form-urlencoded");
+
+    curl_easy_setopt(curl, CURLOPT_URL, "https://accounts.spotify.com/api/token");
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, form);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)&response);
+
+    sched_acquire(PRIO_INTERACTIVE);
+    CURLcode res = curl_easy_perform(curl);
+    sched_release(PRIO_INTERACTIVE);
+    http_account(curl);
+    curl_slist_free_all(headers);
+    http_release(curl);
+
+    bool ok = false;
+    if (res == CURLE_OK && response.size != 0) {
+        cJSON *json = cJSON_ParseArenaWithLength(response.memory, response.size);
+        if (json) {
+            cJSON *access_token_json = cJSON_GetObjectItemCaseSensitive(json, "access_token");
+            cJSON *refresh_token_json = cJSON_GetObjectItemCaseSensitive(json, "refresh_token");
+            cJSON *expires_in_json = cJSON_GetObjectItemCaseSensitive(json, "expires_in");
+
+            if (cJSON_IsString(access_token_json) && cJSON_IsNumber(expires_in_json)) {
+                auth_set_token(access_token_json->valuestring);
+
+                pthread_mutex_lock(&spclient_mutex);
+                // refreshes may or may not rotate the refresh token
+                if (cJSON_IsString(refresh_token_json)) {
+                    snprintf(spclient.refresh_token, sizeof(spclient.refresh_token), "%s",
+                        refresh_token_json->valuestring);
+                }
+                spclient.expiry = get_current_time() + (uint64_t)expires_in_json->valueint * 1000;
+                pthread_mutex_unlock(&spclient_mutex);
+                ok = true;
+            } else {
+                fprintf(stderr, "Token endpoint error: %s\n",
+                    cJSON_GetStringValue(cJSON_GetObjectItemCaseSensitive(json, "error")));
+            }
+            cJSON_Delete(json);
+        }
+    }
+
+    body_release(&response);
+    return ok;
+}
+
+void* http_server_thread(void *arg) {
+    AuthData *adata = (AuthData *)arg;
+    int server_fd;
+    int client_fd;
+    struct sockaddr_in addr;
+    int opt = 1;
+    socklen_t addrlen = sizeof(addr);
+    char buffer[2048] = {0};
+
+    if ((server_fd = socket(AF_INET, SOCK_STREAM, 0)) == -1) {
+        printf("socket creation failed\n");
+        free(adata);
+        return NULL;
+    }
+
+    if (setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt))) {
+        perror("set sock options reuseaddr error");
+        free(adata);
+        close(server_fd);
+        return NULL;
+    }
+
+    if (setsockopt(server_fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt))) {
+        perror("set sock options reuseport error");
+        free(adata);
+        close(server_fd);
+        return NULL;
+    }
+
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = INADDR_ANY;
+    addr.sin_port = htons(8889);
+
+    if (bind(server_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror("bind failed");
+        free(adata);
+        close(server_fd);
+        return NULL;
+    }
+
+    if (listen(server_fd, 3) < 0) {
+        perror("listen failed");
+        free(adata);
+        close(server_fd);
+        return NULL;
+    }
+
+    if ((client_fd = accept(server_fd, (struct sockaddr *)&addr, &addrlen)) < 0) {
+        perror("accept failed");
+        free(adata);
+        close(server_fd);
+        return NULL;
+    }
+
+    read(client_fd, buffer, sizeof(buffer) - 1);
+
+    char *code = NULL;
+    char *state = NULL;
+    char *query = strstr(buffer, "GET /callback?");
+    if (query) {
+        query += strlen("GET /callback?");
+        char *end = strstr(query, " ");
+        if (end) {
+            *end = '\0';
+        }
+
+        char *param = strtok(query, "&");
+        while (param != NULL) {
+            if (strncmp(param, "code=", 5) == 0) {
+                code = param + 5;
+            } else if (strncmp(param, "state=", 6) == 0) {
+                state = param + 6;
+            }
+
+            param = strtok(NULL, "&");
+        }
+    }
+
+    if (code == NULL || state == NULL || strcmp(state, adata->state) != 0) {
+        fprintf(stderr, "code or state is null\n");
+        goto cleanup;
+    }
+
+    pthread_mutex_lock(&spclient_mutex);
+    snprintf(spclient.client_id, sizeof(spclient.client_id), "%s", adata->client_id);
+    snprintf(spclient.client_secret, sizeof(spclient.client_secret), "%s", adata->client_secret);
+    pthread_mutex_unlock(&spclient_mutex);
+
+    char pdata[1024];
+    snprintf(pdata, sizeof(pdata),
+        "grant_type=authorization_code&"
+        "code=%s&"
+        "redirect_uri=%s&"
+        "client_id=%s&"
+        "client_secret=%s",
+        code, adata->redirect_uri, adata->client_id, adata->client_secret);
+
+    if (token_request(pdata)) {
+        pthread_mutex_lock(&logged_in_mutex);
+        logged_in = true;
+        pthread_mutex_unlock(&logged_in_mutex);
+    }
+
+    cleanup:
+        char *http_response = "HTTP/1.1 200 OK\r\nContent-Type: text/html\r\n\r\n<html><body>Login successful! You can close this window.</body></html>";
+        send(client_fd, http_response, strlen(http_response), 0);
+        close(client_fd);
+        close(server_fd);
+        free(adata);
+        return NULL;
+}
+
+static void json_stream_token_put(JsonStream *js, char c) {
+    // long strings are truncated, the rest of the token is still consumed
+    if (js->token_len < sizeof(js->token) - 1) {
+        js->token[js->token_len++] = c;
+    }
+}
+
+static void json_stream_put_utf8(JsonStream *js, unsigned cp) {
+    if (cp < 0x80) {
+        json_stream_token_put(js, (char)cp);
+    } else if (cp < 0x800) {
+        json_stream_token_put(js, (char)(0xC0 | (cp >> 6)));
+        json_stream_token_put(js, (char)(0x80 | (cp & 0x3F)));
+    } else if (cp < 0x10000) {
+        json_stream_token_put(js, (char)(0xE0 | (cp >> 12)));
+        json_stream_token_put(js, (char)(0x80 | ((cp >> 6) & 0x3F)));
+        json_stream_token_put(js, (char)(0x80 | (cp & 0x3F)));
+    } else {
+        json_stream_token_put(js, (char)(0xF0 | (cp >> 18)));
+        json_stream_token_put(js, (char)(0x80 | ((cp >> 12) & 0x3F)));
+        json_stream_token_put(js, (char)(0x80 | ((cp >> 6) & 0x3F)));
+        json_stream_token_put(js, (char)(0x80 | (cp & 0x3F)));
+    }
+}
+
+static bool json_stream_in_array(const JsonStream *js) {
+    return js->depth > 0 && (js->array_bits >> (js->depth - 1)) & 1;
+}
+
+static void json_stream_emit(JsonStream *js, JsonValueKind kind) {
+    js->token[js->token_len] = '\0';
+    if (!js->on_value || js->depth > JSON_STREAM_FRAMES) {
+        return;
+    }
+
+    char path[JSON_STREAM_FRAMES * (JSON_STREAM_KEY + 2)];
+    size_t used = 0;
+    path[0] = '\0';
+    for (int i = 0; i < js->depth; i++) {
+        if ((js->array_bits >> i) & 1) {
+            used += snprintf(path + used, sizeof(path) - used, "[%d]", js->frames[i].index);
+        } else {
+            used += snprintf(path + used, sizeof(path) - used, "%s%s", i ? "." : "", js->frames[i].key);
+        }
+        if (used >= sizeof(path)) {
+            return;
+        }
+    }
+
+    js->on_value(js->user, path, kind, js->token);
+}
+
+static bool json_stream_push(JsonStream *js, bool is_array) {
+    if (js->depth >= JSON_STREAM_MAX_DEPTH) {
+        return false;
+    }
+
+    if (is_array) {
+        js->array_bits |= (uint64_t)1 << js->depth;
+    } else {
+        js->array_bits &= ~((uint64_t)1 << js->depth);
+    }
+    if (js->depth < JSON_STREAM_FRAMES) {
+        js->frames[js->depth].index = 0;
+        js->frames[js->depth].key[0] = '\0';
+    }
+    js->depth++;
+    js->started = true;
+    js->state = is_array ? JS_VALUE : JS_KEY;
+    return true;
+}
+
+static bool json_stream_pop(JsonStream *js, char c) {
+    if (js->depth == 0 || (c == ']') != json_stream_in_array(js)) {
+        return false;
+    }
+
+    js->depth--;
+    js->state = JS_AFTER;
+    if (js->depth == 0) {
+        js->done = true;
+    }
+    return true;
+}
+
+static bool json_stream_literal_end(JsonStream *js) {
+    js->token[js->token_len] = '\0';
+    if (strcmp(js->token, "true") == 0) {
+        json_stream_emit(js, JSON_VALUE_TRUE);
+    } else if (strcmp(js->token, "false") == 0) {
+        json_stream_emit(js, JSON_VALUE_FALSE);
+    } else if (strcmp(js->token, "null") == 0) {
+        json_stream_emit(js, JSON_VALUE_NULL);
+    } else if (js->token_len > 0 && (js->token[0] == '-' || (js->token[0] >= '0' && js->token[0] <= '9'))) {
+        json_stream_emit(js, JSON_VALUE_NUMBER);
+    } else {
+        return false;
+    }
+
+    js->state = JS_AFTER;
+    return true;
+}
+
+static bool json_stream_char(JsonStream *js, char c) {
+    bool space = c == ' ' || c == '\t' || c == '\n' || c == '\r';
+
+    switch (js->state) {
+        case JS_STRING:
+            if (c == '"') {
+                js->token[js->token_len] = '\0';
+                if (js->string_is_key) {
+                    if (js->depth <= JSON_STREAM_FRAMES) {
+                        // keys past the frame size are cut, none of the paths we match are that long
+                        size_t len = js->token_len < JSON_STREAM_KEY - 1 ? js->token_len : JSON_STREAM_KEY - 1;
+                        memcpy(js->frames[js->depth - 1].key, js->token, len);
+                        js->frames[js->depth - 1].key[len] = '\0';
+                    }
+                    js->state = JS_COLON;
+                } else {
+                    json_stream_emit(js, JSON_VALUE_STRING);
+                    js->state = JS_AFTER;
+                }
+            } else if (c == '\\') {
+                js->state = JS_ESCAPE;
+            } else {
+                json_stream_token_put(js, c);
+            }
+            return true;
+
+        case JS_ESCAPE:
+            js->state = JS_STRING;
+            switch (c) {
+                case 'b': json_stream_token_put(js, '\b'); break;
+                case 'f': json_stream_token_put(js, '\f'); break;
+                case 'n': json_stream_token_put(js, '\n'); break;
+                case 'r': json_stream_token_put(js, '\r'); break;
+                case 't': json_stream_token_put(js, '\t'); break;
+                case 'u':
+                    js->state = JS_UNICODE;
+                    js->codepoint = 0;
+                    js->hex_left = 4;
+                    break;
+                default: json_stream_token_put(js, c); break;
+            }
+            return true;
+
+        case JS_UNICODE: {
+            int digit;
+            if (c >= '0' && c <= '9') {
+                digit = c - '0';
+            } else if (c >= 'a' && c <= 'f') {
+                digit = c - 'a' + 10;
+            } else if (c >= 'A' && c <= 'F') {
+                digit = c - 'A' + 10;
+            } else {
+                return false;
+            }
+
+            js->codepoint = (js->codepoint << 4) | digit;
+            if (--js->hex_left > 0) {
+                return true;
+            }
+
+            js->state = JS_STRING;
+            if (js->codepoint >= 0xD800 && js->codepoint <= 0xDBFF) {
+                // first half of a surrogate pair, wait for the second \u
+                js->high_surrogate = js->codepoint;
+            } else if (js->codepoint >= 0xDC00 && js->codepoint <= 0xDFFF && js->high_surrogate) {
+                json_stream_put_utf8(js, 0x10000 + ((js->high_surrogate - 0xD800) << 10) + (js->codepoint - 0xDC00));
+                js->high_surrogate = 0;
+            } else {
+                json_stream_put_utf8(js, js->codepoint);
+                js->high_surrogate = 0;
+            }
+            return true;
+        }
+
+        case JS_LITERAL:
+            if (space || c == ',' || c == '}' || c == ']') {
+                // the delimiter still belongs to the enclosing container
+                return json_stream_literal_end(js) && json_stream_char(js, c);
+            }
+            json_stream_token_put(js, c);
+            return true;
+
+        default:
+            break;
+    }
+
+    if (space) {
+        return true;
+    }
+
+    switch (js->state) {
+        case JS_VALUE:
+            js->token_len = 0;
+            if (c == '{' || c == '[') {
+                return json_stream_push(js, c == '[');
+            } else if (c == ']') {
+                // empty array
+                return json_stream_pop(js, c);
+            } else if (c == '"') {
+                js->string_is_key = false;
+                js->state = JS_STRING;
+                return js->depth > 0;
+            } else if (c == '-' || (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z')) {
+                json_stream_token_put(js, c);
+                js->state = JS_LITERAL;
+                return js->depth > 0;
+            }
+            return false;
+
+        case JS_KEY:
+            if (c == '"') {
+                js->token_len = 0;
+                js->string_is_key = true;
+                js->state = JS_STRING;
+                return true;
+            }
+            return c == '}' && json_stream_pop(js, c);
+
+        case JS_COLON:
+            if (c != ':') {
+                return false;
+            }
+            js->state = JS_VALUE;
+            return true;
+
+        case JS_AFTER:
+            if (js->done) {
+                return false;
+            }
+            if (c == ',') {
+                if (json_stream_in_array(js)) {
+                    if (js->depth <= JSON_STREAM_FRAMES) {
+                        js->frames[js->depth - 1].index++;
+                    }
+                    js->state = JS_VALUE;
+                } else {
+                    js->state = JS_KEY;
+                }
+                return true;
+            }
+            return (c == '}' || c == ']') && json_stream_pop(js, c);
+
+        default:
+            return false;
+    }
+}
+
+// feeds the next chunk, false once the input stops being valid json
+bool json_stream_feed(JsonStream *js, const char *data, size_t len) {
+    for (size_t i = 0; i < len && !js->failed; i++) {
+        if (!json_stream_char(js, data[i])) {
+            js->failed = true;
+        }
+    }
+
+    return !js->failed;
+}
+
+static size_t json_stream_callback(void *content, size_t size, size_t n, void *user) {
+    size_t realsize = size * n;
+    // returning short aborts the transfer, no point downloading garbage
+    return json_stream_feed((JsonStream *)user, (const char *)content, realsize) ? realsize : 0;
+}
+
+static void copy_field(char *dst, size_t len, const char *src) {
+    snprintf(dst, len, "%s", src);
+}
+
+static void player_extract_value(void *user, const char *path, JsonValueKind kind, const char *text) {
+    PlayerExtract *out = (PlayerExtract *)user;
+    SongInfo *song = out->song;
+
+    if (strncmp(path, "error", 5) == 0 && (path[5] == '.' || path[5] == '\0')) {
+        out->error = true;
+    } else if (strcmp(path, "is_playing") == 0) {
+        out->is_playing = kind == JSON_VALUE_TRUE;
+    } else if (strcmp(path, "shuffle_state") == 0) {
+        out->shuffle = kind == JSON_VALUE_TRUE;
+    } else if (strcmp(path, "progress_ms") == 0 && kind == JSON_VALUE_NUMBER) {
+        song->progress = atoi(text) / 1000;
+    } else if (strcmp(path, "device.is_active") == 0) {
+        out->device.active = kind == JSON_VALUE_TRUE;
+    } else if (kind != JSON_VALUE_STRING && kind != JSON_VALUE_NUMBER) {
+        return;
+    } else if (strcmp(path, "device.id") == 0) {
+        copy_field(out->device.id, sizeof(out->device.id), text);
+    } else if (strcmp(path, "device.name") == 0) {
+        copy_field(out->device.name, sizeof(out->device.name), text);
+    } else if (strcmp(path, "device.volume_percent") == 0) {
+        out->device.volume = atoi(text);
+    } else if (strcmp(path, "item.id") == 0) {
+        copy_field(out->track_id, sizeof(out->track_id), text);
+    } else if (strcmp(path, "item.name") == 0) {
+        copy_field(song->title, sizeof(song->title), text);
+    } else if (strcmp(path, "item.duration_ms") == 0) {
+        song->duration = atoi(text) / 1000;
+    } else if (strcmp(path, "item.album.name") == 0) {
+        copy_field(song->album, sizeof(song->album), text);
+    } else if (strncmp(path, "item.album.images[", 18) == 0) {
+        char *end;
+        long i = strtol(path + 18, &end, 10);
+        if (i < 0 || i >= ART_VARIANTS) {
+            return;
+        }
+        if (strcmp(end, "].url") == 0) {
+            copy_field(song->images[i].url, sizeof(song->images[i].url), text);
+        } else if (strcmp(end, "].width") == 0) {
+            song->images[i].width = atoi(text);
+        } else {
+            return;
+        }
+        if (i >= song->image_count) {
+            song->image_count = i + 1;
+        }
+    } else if (strcmp(path, "item.artists[0].name") == 0) {
+        copy_field(song->artist, sizeof(song->artist), text);
+    }
+}
+
+bool fetch_current_state(SongInfo *song) {
+    // market=from_token drops the available_markets lists from item and album
+    const char *url = "https://api.spotify.com/v1/me/player?market=from_token";
+    CURL *curl = http_acquire(url);
+    if (!curl) {
+        return false;
+    }
+
+    PlayerExtract extract = { .song = song };
+    JsonStream stream = { .on_value = player_extract_value, .user = &extract };
+
+    char token[256];
+    char auth_header[300];
+    auth_get_token(token, sizeof(token));
+    snprintf(auth_header, sizeof(auth_header), "Authorization: Bearer %s", token);
+
+    struct curl_slist *headers = NULL;
+    headers = curl_slist_append(headers, auth_header);
+    headers = curl_slist_append(headers, "Content-Type: application/json");
+
+    curl_easy_setopt(curl, CURLOPT_URL, url);
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, json_stream_callback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)&stream);
+
+    rate_wait(PRIO_STATE);
+    sched_acquire(PRIO_STATE);
+    CURLcode res = curl_easy_perform(curl);
+    sched_release(PRIO_STATE);
+    long status = 0;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+    api_observe(curl, status);
+    http_account(curl);
+    http_release(curl);
+    curl_slist_free_all(headers);
+
+    // 204 means nothing is playing, the body is empty and the stream never starts
+    if (res != CURLE_OK || !stream.done || extract.error) {
+        return false;
+    }
+
+    pthread_mutex_lock(&spclient_mutex);
+    if (extract.device.id[0]) {
+        copy_field(spclient.current_playing_id, sizeof(spclient.current_playing_id), extract.device.id);
+    }
+    if (extract.track_id[0]) {
+        copy_field(spclient.current_track_id, sizeof(spclient.current_track_id), extract.track_id);
+    }
+    spclient.is_playing = extract.is_playing;
+    spclient.shuffle = extract.shuffle;
+    pthread_mutex_unlock(&spclient_mutex);
+
+    return true;
+}
+
+static uint64_t art_cache_hash(const char *url, int size) {
+    // fnv-1a, size is mixed in so one url can be cached at several sizes. keys the disk and texture caches
+    uint64_t hash = 14695981039346656037ULL;
+    for (const char *c = url; *c; c++) {
+        hash = (hash ^ (unsigned char)*c) * 1099511628211ULL;
+    }
+    return (hash ^ (uint64_t)size) * 1099511628211ULL;
+}
+
+static off_t art_cache_entry_offset(int i) {
+    return sizeof(ArtCacheHeader) + (off_t)i * sizeof(ArtCacheEntry);
+}
+
+static off_t art_cache_slot_offset(int i) {
+    return ART_CACHE_INDEX_BYTES + (off_t)i * ART_CACHE_SLOT_BYTES;
+}
+
+// the cache is optional, if the file can't be opened art is always downloaded
+bool art_cache_open() {
+    char dir[512];
+    const char *xdg = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+    if (xdg && xdg[0]) {
+        snprintf(dir, sizeof(dir), "%s/pithing", xdg);
+    } else if (home && home[0]) {
+        snprintf(dir, sizeof(dir), "%s/.cache", home);
+        mkdir(dir, 0700);
+        snprintf(dir, sizeof(dir), "%s/.cache/pithing", home);
+    } else {
+        return false;
+    }
+    mkdir(dir, 0700);
+
+    char path[600];
+    snprintf(path, sizeof(path), "%s/art.cache", dir);
+    int fd = open(path, O_RDWR | O_CREAT, 0600);
+    if (fd < 0) {
+        fprintf(stderr, "Art cache disabled, can't open %s\n", path);
+        return false;
+    }
+
+    ArtCacheHeader header = {0};
+    bool usable = pread(fd, &header, sizeof(header), 0) == sizeof(header) &&
+        header.magic == ART_CACHE_MAGIC && header.version == ART_CACHE_VERSION &&
+        header.capacity == ART_CACHE_ENTRIES && header.slot_bytes == ART_CACHE_SLOT_BYTES;
+    ssize_t index_bytes = sizeof(art_cache.entries);
+    if (usable) {
+        usable = pread(fd, art_cache.entries, index_bytes, art_cache_entry_offset(0)) == index_bytes;
+    }
+
+    if (!usable) {
+        // new file or an older layout, start over
+        memset(art_cache.entries, 0, sizeof(art_cache.entries));
+        header = (ArtCacheHeader){ ART_CACHE_MAGIC, ART_CACHE_VERSION, ART_CACHE_ENTRIES, ART_CACHE_SLOT_BYTES, 0, 0 };
+        if (ftruncate(fd, 0) != 0 ||
+            ftruncate(fd, art_cache_slot_offset(ART_CACHE_ENTRIES)) != 0 ||
+            pwrite(fd, &header, sizeof(header), 0) != sizeof(header) ||
+            pwrite(fd, art_cache.entries, index_bytes, art_cache_entry_offset(0)) != index_bytes) {
+            fprintf(stderr, "Art cache disabled, can't initialize %s\n", path);
+            close(fd);
+            return false;
+        }
+    }
+
+    art_cache.header = header;
+    art_cache.fd = fd;
+    return true;
+}
+
+void art_cache_close() {
+    if (art_cache.fd >= 0) {
+        close(art_cache.fd);
+        art_cache.fd = -1;
+    }
+    printf("Art cache: %u hits, %u misses, %u stores (%zu KiB written, %zu KiB as RGBA8)\n",
+        art_cache.hits, art_cache.misses, art_cache.stores,
+        art_cache.stored_bytes / 1024, art_cache.stored_rgba_bytes / 1024);
+}
+
+// entries in another format than the textures use (the driver changed) are misses
+static int art_cache_find(const char *url, int size, int format) {
+    uint64_t hash = art_cache_hash(url, size);
+    for (int i = 0; i < ART_CACHE_ENTRIES; i++) {
+        ArtCacheEntry *entry = &art_cache.entries[i];
+        if (entry->valid && entry->hash == hash && entry->format == format && strcmp(entry->url, url) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// maps a cached image read only, the pixels stay in the page cache and go
+// straight to the gpu. the slot stays pinned until art_cache_unmap()
+bool art_cache_map(const char *url, int size, Image *image, size_t *bytes, int *slot) {
+    if (art_cache.fd < 0) {
+        return false;
+    }
+
+    pthread_mutex_lock(&art_cache.mutex);
+    int i = art_cache_find(url, size, atomic_load(&art_format));
+    ArtCacheEntry entry = {0};
+    if (i >= 0) {
+        entry = art_cache.entries[i];
+        art_cache.pins[i]++;
+        art_cache.hits++;
+    } else {
+        art_cache.misses++;
+    }
+    pthread_mutex_unlock(&art_cache.mutex);
+
+    if (i < 0) {
+        return false;
+    }
+
+    void *pixels = mmap(NULL, entry.bytes, PROT_READ, MAP_PRIVATE, art_cache.fd, art_cache_slot_offset(i));
+    if (pixels == MAP_FAILED) {
+        pthread_mutex_lock(&art_cache.mutex);
+        art_cache.pins[i]--;
+        pthread_mutex_unlock(&art_cache.mutex);
+        return false;
+    }
+
+    *image = (Image){ .data = pixels, .width = entry.width, .height = entry.height, .mipmaps = 1, .format = entry.format };
+    *bytes = entry.bytes;
+    *slot = i;
+    return true;
+}
+
+void art_cache_unmap(Image image, size_t bytes, int slot) {
+    munmap(image.data, bytes);
+
+    pthread_mutex_lock(&art_cache.mutex);
+    art_cache.pins[slot]--;
+    pthread_mutex_unlock(&art_cache.mutex);
+}
+
+// worker side, called with a freshly decoded image
+void art_cache_store(const char *url, int size, const Image *image) {
+    if (art_cache.fd < 0 || !image->data) {
+        return;
+    }
+
+    int bytes = GetPixelDataSize(image->width, image->height, image->format);
+    if (bytes <= 0 || bytes > ART_CACHE_SLOT_BYTES || strlen(url) >= sizeof(art_cache.entries[0].url)) {
+        return;
+    }
+
+    pthread_mutex_lock(&art_cache.mutex);
+    if (art_cache_find(url, size, image->format) >= 0) {
+        pthread_mutex_unlock(&art_cache.mutex);
+        return;
+    }
+
+    // round robin, stepping over slots a queued upload still has mapped
+    int i = art_cache.header.next;
+    for (int tries = 0; art_cache.pins[i] > 0; tries++) {
+        if (tries == ART_CACHE_ENTRIES) {
+            pthread_mutex_unlock(&art_cache.mutex);
+            return;
+        }
+        i = (i + 1) % ART_CACHE_ENTRIES;
+    }
+    art_cache.header.next = (i + 1) % ART_CACHE_ENTRIES;
+
+    // invalid and pinned while it is rewritten, so no map or other store
+    // touches the slot and the disk writes below can run without the lock,
+    // the render thread takes it on every thumbnail miss
+    art_cache.entries[i] = (ArtCacheEntry){0};
+    art_cache.pins[i]++;
+    pthread_mutex_unlock(&art_cache.mutex);
+
+    ArtCacheEntry entry = {
+        .hash = art_cache_hash(url, size),
+        .width = image->width,
+        .height = image->height,
+        .format = image->format,
+        .bytes = bytes,
+        .valid = 1
+    };
+    snprintf(entry.url, sizeof(entry.url), "%s", url);
+
+    // the entry is invalid on disk while its pixels are rewritten, a crash
+    // in between loses the entry instead of serving half an image
+    ArtCacheEntry cleared = {0};
+    bool ok = pwrite(art_cache.fd, &cleared, sizeof(cleared), art_cache_entry_offset(i)) == sizeof(cleared) &&
+        pwrite(art_cache.fd, image->data, bytes, art_cache_slot_offset(i)) == bytes &&
+        pwrite(art_cache.fd, &entry, sizeof(entry), art_cache_entry_offset(i)) == sizeof(entry);
+
+    pthread_mutex_lock(&art_cache.mutex);
+    // another worker may have stored the same art meanwhile, the first one wins
+    ok = ok && art_cache_find(url, size, image->format) < 0;
+    if (ok) {
+        art_cache.entries[i] = entry;
+        art_cache.stores++;
+        art_cache.stored_bytes += bytes;
+        art_cache.stored_rgba_bytes += GetPixelDataSize(image->width, image->height, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+    }
+    art_cache.pins[i]--;
+    ArtCacheHeader header = art_cache.header;
+    pthread_mutex_unlock(&art_cache.mutex);
+
+    // only the round robin position, a stale one from a racing store just
+    // means the next run starts overwriting a slot early
+    if (ok) {
+        pwrite(art_cache.fd, &header, sizeof(header), 0);
+    }
+}
+
+// worker side of the art pipeline, returns a decoded size x size image or one with no data
+Image load_album_art(const char *image_url, int size, RequestPriority prio) {
+    Image img = {0};
+    CURL *curl = http_acquire(image_url);
+    if (!curl) {
+        return img;
+    }
+
+    MemoryBuffer imgBuffer = { .curl = curl };
+
+    curl_easy_setopt(curl, CURLOPT_URL, image_url);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)&imgBuffer);
+    sched_acquire(prio);
+    CURLcode res = curl_easy_perform(curl);
+    sched_release(prio);
+    http_account(curl);
+    http_release(curl);
+
+    if (res == CURLE_OK && imgBuffer.size > 0) {
+        const unsigned char *data = (const unsigned char *)imgBuffer.memory;
+        // i.scdn.co is all jpeg, let libjpeg skip most of the work for small
+        // targets and leave anything else (or a jpeg it chokes on) to stb
+        if (!art_is_jpeg(data, imgBuffer.size) || !art_decode_jpeg(data, imgBuffer.size, size, &img)) {
+            img = LoadImageFromMemory(art_is_jpeg(data, imgBuffer.size) ? ".jpg" : ".png", data, imgBuffer.size);
+        }
+        if (img.data && (img.width != size || img.height != size) && !art_resize_image(&img, size, size)) {
+            ImageResize(&img, size, size);
+        }
+        // the disk cache and the textures expect RGBA8, or ETC on top of that
+        if (img.data && img.format != PIXELFORMAT_UNCOMPRESSED_R8G8B8A8) {
+            ImageFormat(&img, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+        }
+        if (img.data && atomic_load(&art_format) == PIXELFORMAT_COMPRESSED_ETC2_RGB && !art_encode_etc(&img)) {
+            art_image_unload(img);
+            img = (Image){0};
+        }
+    }
+
+    body_release(&imgBuffer);
+    return img;
+}
+
+// art_pipeline.mutex must be held
+static void art_push_ready(ArtJob *job) {
+    if (art_pipeline.ready_tail) {
+        art_pipeline.ready_tail->next = job;
+    } else {
+        art_pipeline.ready = job;
+    }
+    art_pipeline.ready_tail = job;
+}
+
+void* art_worker_thread(void *arg) {
+    while (running) {
+        pthread_mutex_lock(&art_pipeline.mutex);
+        while (running && !art_pipeline.pending) {
+            pthread_cond_wait(&art_pipeline.cond, &art_pipeline.mutex);
+        }
+        if (!running) {
+            pthread_mutex_unlock(&art_pipeline.mutex);
+            break;
+        }
+
+        // now playing art goes ahead of grid thumbnails
+        ArtJob **pick = &art_pipeline.pending;
+        for (ArtJob **it = &art_pipeline.pending; *it; it = &(*it)->next) {
+            if ((*it)->priority < (*pick)->priority) {
+                pick = it;
+            }
+        }
+        ArtJob *job = *pick;
+        *pick = job->next;
+        job->next = NULL;
+        pthread_mutex_unlock(&art_pipeline.mutex);
+
+        job->image = load_album_art(job->url, job->size, job->priority);
+        art_cache_store(job->url, job->size, &job->image);
+
+        pthread_mutex_lock(&art_pipeline.mutex);
+        art_push_ready(job);
+        art_pipeline.decoded++;
+        pthread_mutex_unlock(&art_pipeline.mutex);
+    }
+
+    return NULL;
+}
+
+bool art_pipeline_start() {
+    for (int i = 0; i < ART_WORKERS; i++) {
+        if (pthread_create(&art_pipeline.workers[i], NULL, art_worker_thread, NULL) != 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void art_job_free(ArtJob *job) {
+    if (job->mapped) {
+        art_cache_unmap(job->image, job->map_bytes, job->map_slot);
+    } else if (job->image.data) {
+        art_image_unload(job->image);
+    }
+    free(job);
+}
+
+// running must already be cleared
+void art_pipeline_stop() {
+    pthread_mutex_lock(&art_pipeline.mutex);
+    pthread_cond_broadcast(&art_pipeline.cond);
+    pthread_mutex_unlock(&art_pipeline.mutex);
+    for (int i = 0; i < ART_WORKERS; i++) {
+        pthread_join(art_pipeline.workers[i], NULL);
+    }
+
+    while (art_pipeline.pending) {
+        ArtJob *next = art_pipeline.pending->next;
+        art_job_free(art_pipeline.pending);
+        art_pipeline.pending = next;
+    }
+    while (art_pipeline.ready) {
+        ArtJob *next = art_pipeline.ready->next;
+        art_job_free(art_pipeline.ready);
+        art_pipeline.ready = next;
+    }
+    art_pipeline.ready_tail = NULL;
+
+    printf("Art pipeline: %u images decoded, %u uploaded, %u dropped as stale\n",
+        art_pipeline.decoded, art_pipeline.uploaded, art_pipeline.dropped);
+
+    unsigned hits, misses, other;
+    art_slab_stats(&hits, &misses, &other);
+    printf("Decode slab: %u hits, %u misses with the slab full, %u other sizes\n", hits, misses, other);
+}
+
+// drops jobs for url that no worker has picked up yet
+static void art_cancel_pending(const char *url, bool now_playing) {
+    pthread_mutex_lock(&art_pipeline.mutex);
+    ArtJob **it = &art_pipeline.pending;
+    while (*it) {
+        if ((*it)->now_playing == now_playing && strcmp((*it)->url, url) == 0) {
+            ArtJob *job = *it;
+            *it = job->next;
+            free(job);
+        } else {
+            it = &(*it)->next;
+        }
+    }
+    pthread_mutex_unlock(&art_pipeline.mutex);
+}
+
+// needs the gl context, call after InitWindow() and before any art texture exists
+void art_format_init() {
+    const char *env = getenv("PITHING_ETC");
+    if (!env || strcmp(env, "0") != 0) {
+        // raylib hands back no texture for a compressed format the driver doesn't list
+        Image probe = GenImageColor(4, 4, BLACK);
+        if (art_encode_etc(&probe)) {
+            Texture2D texture = LoadTextureFromImage(probe);
+            if (texture.id != 0) {
+                atomic_store(&art_format, PIXELFORMAT_COMPRESSED_ETC2_RGB);
+                UnloadTexture(texture);
+            }
+        }
+        art_image_unload(probe);
+    }
+
+    printf("Art textures: %s\n", atomic_load(&art_format) == PIXELFORMAT_COMPRESSED_ETC2_RGB ? "ETC2" : "RGBA8");
+}
+
+// UpdateTextureRec only takes uncompressed pixels, compressed ones go straight
+// to gl and have to start on a 4x4 block boundary
+static void art_update_rect(Texture2D texture, Rectangle rect, const Image *image) {
+    if (image->format != PIXELFORMAT_COMPRESSED_ETC2_RGB) {
+        UpdateTextureRec(texture, rect, image->data);
+        return;
+    }
 
-    curl_easy_setopt(curl, CURLOPT_URL, endpoint);
-    curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "PUT");
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-    if (payload) {
-        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, payload);
+    // 0 when the driver has no ETC2, art_format_init() never picks it then
+    unsigned int internal_format = 0, gl_format = 0, gl_type = 0;
+    rlGetGlTextureFormats(image->format, &internal_format, &gl_format, &gl_type);
+    if (internal_format == 0) {
+        return;
     }
-        
-    CURLcode res = curl_easy_perform(curl);
-    curl_slist_free_all(headers);
-    curl_easy_cleanup(curl);
 
-    return (res == CURLE_OK);
+    // runs before BeginDrawing() so no batch is pending, rlEnableTexture() and
+    // rlDisableTexture() keep the binding where rlgl's own uploads leave it
+    rlEnableTexture(texture.id);
+    glCompressedTexSubImage2D(ART_GL_TEXTURE_2D, 0, rect.x, rect.y, rect.width, rect.height, internal_format,
+        GetPixelDataSize(image->width, image->height, image->format), image->data);
+    rlDisableTexture();
 }
 
-// change this to use new spotify_get()
-bool fetch_current_state(SongInfo *song) {
-    CURL *curl = curl_easy_init();
-    if (!curl) {
-        return false;
+static Rectangle texture_cache_cell(int cell) {
+    return (Rectangle){
+        (cell % THUMB_ATLAS_COLS) * THUMB_CELL + THUMB_ATLAS_PAD,
+        (cell / THUMB_ATLAS_COLS) * THUMB_CELL + THUMB_ATLAS_PAD,
+        ART_THUMB_SIZE, ART_THUMB_SIZE
+    };
+}
+
+// needs the gl context, call after InitWindow()
+bool texture_cache_init() {
+    for (int i = 0; i < TEXTURE_CACHE_BUCKETS; i++) {
+        texture_cache.buckets[i] = -1;
+    }
+    texture_cache.lru_head = -1;
+    texture_cache.lru_tail = -1;
+
+    // ETC has no alpha, so the placeholder is blended onto the background up front
+    bool etc = atomic_load(&art_format) == PIXELFORMAT_COMPRESSED_ETC2_RGB;
+    Color placeholder = Fade(DARKGRAY, 0.5f);
+    if (etc) {
+        placeholder = ColorAlphaBlend(GetColor(GuiGetStyle(DEFAULT, BACKGROUND_COLOR)), placeholder, WHITE);
     }
 
-    MemoryBuffer region = {
-        malloc(1),
-        0
-    };
-    if (!region.memory) {
+    Image atlas = GenImageColor(THUMB_ATLAS_SIZE, THUMB_ATLAS_SIZE, BLANK);
+    Rectangle cell = texture_cache_cell(0);
+    ImageDrawRectangleRec(&atlas, cell, placeholder);
+    Image icon = LoadImage("assets/music.png");
+    if (icon.data) {
+        ImageDraw(&atlas, icon, (Rectangle){0, 0, icon.width, icon.height},
+            (Rectangle){cell.x + cell.width / 4, cell.y + cell.height / 4, cell.width / 2, cell.height / 2}, GRAY);
+        UnloadImage(icon);
+    }
+    if (etc && !art_encode_etc(&atlas)) {
+        art_image_unload(atlas);
         return false;
     }
+    texture_cache.atlas = LoadTextureFromImage(atlas);
+    art_image_unload(atlas);
+    return texture_cache.atlas.id != 0;
+}
 
-    char url[256];
-    snprintf(url, sizeof(url), "https://api.spotify.com/v1/me/player");
+static void texture_cache_lru_unlink(int i) {
+    ArtSlot *slot = &texture_cache.slots[i];
+    if (slot->lru_prev >= 0) {
+        texture_cache.slots[slot->lru_prev].lru_next = slot->lru_next;
+    } else {
+        texture_cache.lru_head = slot->lru_next;
+    }
+    if (slot->lru_next >= 0) {
+        texture_cache.slots[slot->lru_next].lru_prev = slot->lru_prev;
+    } else {
+        texture_cache.lru_tail = slot->lru_prev;
+    }
+    slot->lru_prev = slot->lru_next = -1;
+}
 
-    pthread_mutex_lock(&spclient_mutex);
-    char auth_header[256];
-    snprintf(auth_header, sizeof(auth_header), "Authorization: Bearer %s", spclient.access_token);
-    pthread_mutex_unlock(&spclient_mutex);
+static void texture_cache_lru_push(int i) {
+    ArtSlot *slot = &texture_cache.slots[i];
+    slot->lru_prev = -1;
+    slot->lru_next = texture_cache.lru_head;
+    if (texture_cache.lru_head >= 0) {
+        texture_cache.slots[texture_cache.lru_head].lru_prev = i;
+    } else {
+        texture_cache.lru_tail = i;
+    }
+    texture_cache.lru_head = i;
+}
 
-    struct curl_slist *headers = NULL;
-    headers = curl_slist_append(headers, auth_header);
-    headers = curl_slist_append(headers, "Content-Type: application/json");
+static int texture_cache_find(const char *url, int size, uint64_t hash) {
+    int i = texture_cache.buckets[hash % TEXTURE_CACHE_BUCKETS];
+    while (i >= 0) {
+        ArtSlot *slot = &texture_cache.slots[i];
+        if (slot->hash == hash && slot->size == size && strcmp(slot->url, url) == 0) {
+            return i;
+        }
+        i = slot->hash_next;
+    }
+    return -1;
+}
 
-    curl_easy_setopt(curl, CURLOPT_URL, url);
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)&region);
+static void texture_cache_remove(int i) {
+    ArtSlot *slot = &texture_cache.slots[i];
+    int *link = &texture_cache.buckets[slot->hash % TEXTURE_CACHE_BUCKETS];
+    while (*link != i) {
+        link = &texture_cache.slots[*link].hash_next;
+    }
+    *link = slot->hash_next;
+    texture_cache_lru_unlink(i);
 
-    CURLcode res = curl_easy_perform(curl);
-    curl_easy_cleanup(curl);
-    curl_slist_free_all(headers);
+    if (slot->state == ART_LOADING) {
+        art_cancel_pending(slot->url, false);
+    }
+    *slot = (ArtSlot){0};
+}
 
-    if (res != CURLE_OK || region.size == 0) {
-        free(region.memory);
+static bool art_submit(const char *url, int size, RequestPriority prio, bool now_playing) {
+    ArtJob *job = calloc(1, sizeof(ArtJob));
+    if (!job) {
         return false;
     }
 
-    cJSON *json = cJSON_Parse(region.memory);
-    free(region.memory);
-    if (!json) {
-        return false;
+    snprintf(job->url, sizeof(job->url), "%s", url);
+    job->size = size;
+    job->priority = prio;
+    job->now_playing = now_playing;
+    // a cache hit skips the workers, it only waits for its upload turn
+    job->mapped = art_cache_map(job->url, job->size, &job->image, &job->map_bytes, &job->map_slot);
+
+    pthread_mutex_lock(&art_pipeline.mutex);
+    if (job->mapped) {
+        art_push_ready(job);
+    } else {
+        job->next = art_pipeline.pending;
+        art_pipeline.pending = job;
+        pthread_cond_signal(&art_pipeline.cond);
     }
+    pthread_mutex_unlock(&art_pipeline.mutex);
+    return true;
+}
 
-    cJSON *err = cJSON_GetObjectItem(json, "error");
-    if (err) {
-        cJSON_Delete(json);
-        return false;
+static void art_queue(ArtSlot *slot, RequestPriority prio) {
+    slot->state = ART_LOADING;
+    if (!art_submit(slot->url, slot->size, prio, false)) {
+        slot->state = ART_FAILED;
+        slot->failed_at = get_current_time();
     }
+}
 
-    cJSON *device_json = cJSON_GetObjectItem(json, "device");
-    if (device_json) {
-        cJSON *device_id_json = cJSON_GetObjectItem(json, "id");
-        if (cJSON_IsString(device_id_json)) {
-            pthread_mutex_lock(&spclient_mutex);
-            strncpy(spclient.current_playing_id, device_id_json->valuestring, sizeof(spclient.current_playing_id) - 1);
-            spclient.current_playing_id[sizeof(spclient.current_playing_id) - 1] = '\0';
-            pthread_mutex_unlock(&spclient_mutex);
+// render thread only, call it every frame the image is on screen and draw
+// the returned entry right away, a later art_get() may recycle it
+const ArtSlot *art_get(const char *url, int size, RequestPriority prio) {
+    uint64_t hash = art_cache_hash(url, size);
+    int i = texture_cache_find(url, size, hash);
+    if (i >= 0) {
+        ArtSlot *slot = &texture_cache.slots[i];
+        texture_cache_lru_unlink(i);
+        texture_cache_lru_push(i);
+        if (slot->frame != texture_cache.frame) {
+            slot->frame = texture_cache.frame;
+            texture_cache.hits++;
         }
+        if (slot->state == ART_FAILED && get_current_time() - slot->failed_at >= ART_RETRY_MS) {
+            art_queue(slot, prio);
+        }
+        return slot;
     }
 
-    cJSON *is_playing_json = cJSON_GetObjectItem(json, "is_playing");
-    if (cJSON_IsBool(is_playing_json)) {
-        spclient.is_playing = cJSON_IsTrue(is_playing_json);
+    texture_cache.misses++;
+    for (i = 0; i < TEXTURE_CACHE_ENTRIES && texture_cache.slots[i].used; i++) {
+    }
+    if (i == TEXTURE_CACHE_ENTRIES) {
+        // every cell is taken, the least recently drawn entry gives its cell up
+        i = texture_cache.lru_tail;
+        texture_cache_remove(i);
+        texture_cache.evictions++;
     }
 
-    cJSON *progress_ms_json = cJSON_GetObjectItem(json, "progress_ms");
-    song->progress = (cJSON_IsNumber(progress_ms_json)) ? progress_ms_json->valueint / 1000 : 0;
+    ArtSlot *slot = &texture_cache.slots[i];
+    snprintf(slot->url, sizeof(slot->url), "%s", url);
+    slot->size = size;
+    slot->hash = hash;
+    slot->used = true;
+    slot->frame = texture_cache.frame;
+    slot->hash_next = texture_cache.buckets[hash % TEXTURE_CACHE_BUCKETS];
+    texture_cache.buckets[hash % TEXTURE_CACHE_BUCKETS] = i;
+    texture_cache_lru_push(i);
+
+    art_queue(slot, prio);
+    return slot;
+}
 
-    cJSON *item = cJSON_GetObjectItem(json, "item");
-    if (item) {
-        cJSON *title_json = cJSON_GetObjectItem(item, "name");
-        if (cJSON_IsString(title_json)) {
-            strncpy(song->title, title_json->valuestring, sizeof(song->title) - 1);
-            song->title[sizeof(song->title) - 1] = '\0';
+// smallest variant at least size wide, the largest known one if none is
+// big enough, and the first one when spotify gave no widths at all
+const char *art_pick_variant(const ImageVariant *images, int count, int size) {
+    int best = -1;
+    int largest = -1;
+    int first = -1;
+    for (int i = 0; i < count; i++) {
+        if (!images[i].url[0]) {
+            continue;
         }
-        
-        cJSON *track_id_json = cJSON_GetObjectItem(item, "id");
-        if (cJSON_IsString(track_id_json)) {
-            pthread_mutex_lock(&spclient_mutex);
-            strncpy(spclient.current_track_id, track_id_json->valuestring, 
-                sizeof(spclient.current_track_id) - 1);
-            spclient.current_track_id[sizeof(spclient.current_track_id) - 1] = '\0';
-            pthread_mutex_unlock(&spclient_mutex);
+        if (first < 0) {
+            first = i;
         }
 
-        cJSON *duration_json = cJSON_GetObjectItem(item, "duration_ms");
-        song->duration = (cJSON_IsNumber(duration_json)) ? duration_json->valueint / 1000 : 0;
-
-        cJSON *album = cJSON_GetObjectItem(item, "album");
-        if (album) {
-            cJSON *album_name_json = cJSON_GetObjectItem(album, "name");
-            if (cJSON_IsString(album_name_json)) {
-                strncpy(song->album, album_name_json->valuestring, sizeof(song->album) - 1);
-                song->album[sizeof(song->album) - 1] = '\0';
-            }
-
-            cJSON *images_json = cJSON_GetObjectItem(album, "images");
-            if (images_json && cJSON_IsArray(images_json)) {
-                cJSON *first_image = cJSON_GetArrayItem(images_json, 0);
-                if (first_image) {
-                    cJSON *image_url_json = cJSON_GetObjectItem(first_image, "url");
-                    if (cJSON_IsString(image_url_json)) {
-                        strncpy(song->url, image_url_json->valuestring, sizeof(song->url) - 1);
-                        song->url[sizeof(song->url) - 1] = '\0';
-                    }
-                }
-            }
+        int width = images[i].width;
+        if (width <= 0) {
+            continue;
         }
-
-        cJSON *artists = cJSON_GetObjectItem(item, "artists");
-        if (artists && cJSON_IsArray(artists)) {
-            cJSON *first_artist_json = cJSON_GetArrayItem(artists, 0);
-            if (first_artist_json) {
-                cJSON *arist_name_json = cJSON_GetObjectItem(first_artist_json, "name");
-                if (cJSON_IsString(arist_name_json)) {
-                    strncpy(song->artist, arist_name_json->valuestring, sizeof(song->artist) - 1);
-                    song->artist[sizeof(song->artist) - 1] = '\0';
-                }
-            }
+        if (width >= size && (best < 0 || width < images[best].width)) {
+            best = i;
+        }
+        if (largest < 0 || width > images[largest].width) {
+            largest = i;
         }
     }
-    cJSON_Delete(json);
 
-    return true;
+    int pick = best >= 0 ? best : largest >= 0 ? largest : first;
+    return pick >= 0 ? images[pick].url : NULL;
 }
 
-Texture2D load_album_art(const char *image_url) {
-    Texture2D texture = {0};
-    CURL *curl = curl_easy_init();
-    if (!curl) {
-        return texture;
+// needs the gl context, call after InitWindow()
+bool now_playing_art_init() {
+    Image blank = GenImageColor(ART_SIZE, ART_SIZE, BLANK);
+    if (atomic_load(&art_format) == PIXELFORMAT_COMPRESSED_ETC2_RGB && !art_encode_etc(&blank)) {
+        art_image_unload(blank);
+        return false;
     }
+    for (int i = 0; i < 2; i++) {
+        now_playing_art.textures[i] = LoadTextureFromImage(blank);
+        if (now_playing_art.textures[i].id == 0) {
+            art_image_unload(blank);
+            return false;
+        }
+    }
+    art_image_unload(blank);
+    return true;
+}
 
-    MemoryBuffer imgBuffer = {
-        malloc(1),
-        0
-    };
-    if (!imgBuffer.memory) {
-        return texture;
+void now_playing_art_unload() {
+    for (int i = 0; i < 2; i++) {
+        if (now_playing_art.textures[i].id != 0) {
+            UnloadTexture(now_playing_art.textures[i]);
+        }
     }
+    printf("Now playing art: %u covers swapped in\n", now_playing_art.swaps);
+    now_playing_art = (NowPlayingArt){0};
+}
 
-    curl_easy_setopt(curl, CURLOPT_URL, image_url);
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)&imgBuffer);
-    CURLcode res = curl_easy_perform(curl);
-    curl_easy_cleanup(curl);
+// render thread only, cheap to call every frame with the same images
+void now_playing_art_request(const ImageVariant *images, int count) {
+    const char *url = art_pick_variant(images, count, ART_SIZE);
+    if (!url) {
+        // nothing to show for this track, don't leave the last cover up
+        now_playing_art.shown = false;
+        now_playing_art.url[0] = '\0';
+        now_playing_art.state = ART_EMPTY;
+        return;
+    }
 
-    if (res == CURLE_OK && imgBuffer.size > 0) {
-        Image img = LoadImageFromMemory(".jpg", (unsigned char *)imgBuffer.memory, imgBuffer.size);
-        if (img.data) {
-            ImageResize(&img, 256, 256);
-            texture = LoadTextureFromImage(img);
-            UnloadImage(img);
+    if (strcmp(now_playing_art.url, url) == 0) {
+        if (now_playing_art.state != ART_FAILED || get_current_time() - now_playing_art.failed_at < ART_RETRY_MS) {
+            return;
         }
+    } else if (now_playing_art.state == ART_LOADING) {
+        // skipped past a track before its art arrived
+        art_cancel_pending(now_playing_art.url, true);
     }
 
-    free(imgBuffer.memory);
-    return texture;
-}
-
-void refresh_album_art() {
-    if (albumTexture.id != 0) {
-        UnloadTexture(albumTexture);
-        albumTexture = (Texture2D){0};
+    snprintf(now_playing_art.url, sizeof(now_playing_art.url), "%s", url);
+    now_playing_art.state = ART_LOADING;
+    if (!art_submit(url, ART_SIZE, PRIO_ART, true)) {
+        now_playing_art.state = ART_FAILED;
+        now_playing_art.failed_at = get_current_time();
     }
 }
 
-bool spotify_post(const char *endpoint_base, const char *access_token) {
-    char endpoint[512];
-    pthread_mutex_lock(&spclient_mutex);
-    if (strlen(spclient.current_playing_id) > 0) {
-        snprintf(endpoint, sizeof(endpoint), "%s?device_id=%s", endpoint_base, spclient.current_playing_id);
-    } else {
-        strncpy(endpoint, endpoint_base, sizeof(endpoint) - 1);
-        endpoint[sizeof(endpoint) - 1] = '\0';
+// writes a finished job into the back texture and flips, true if it uploaded
+static bool now_playing_art_land(ArtJob *job) {
+    if (now_playing_art.state != ART_LOADING || strcmp(now_playing_art.url, job->url) != 0) {
+        art_pipeline.dropped++;
+        return false;
     }
-    pthread_mutex_unlock(&spclient_mutex);
 
-    CURL *curl = curl_easy_init();
-    if (!curl) {
+    Image *img = &job->image;
+    if (!img->data || img->width != ART_SIZE || img->height != ART_SIZE || img->format != atomic_load(&art_format)) {
+        now_playing_art.state = ART_FAILED;
+        now_playing_art.failed_at = get_current_time();
         return false;
     }
 
-    struct curl_slist *headers = NULL;
-    char auth_header[256];
-    snprintf(auth_header, sizeof(auth_header), "Authorization: Bearer %s", access_token);
-    headers = curl_slist_append(headers, auth_header);
-    headers = curl_slist_append(headers, "Content-Type: application/json");
-
-    curl_easy_setopt(curl, CURLOPT_URL, endpoint);
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-    curl_easy_setopt(curl, CURLOPT_POST, 1L);
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, "");
+    int back = now_playing_art.front ^ 1;
+    art_update_rect(now_playing_art.textures[back], (Rectangle){0, 0, ART_SIZE, ART_SIZE}, img);
+    now_playing_art.front = back;
+    now_playing_art.shown = true;
+    now_playing_art.state = ART_READY;
+    now_playing_art.swaps++;
+    art_pipeline.uploaded++;
+    return true;
+}
 
-    long response_code = 0;
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, NULL);
-    CURLcode res = curl_easy_perform(curl);
-    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response_code);
+// called once per frame from main(), uploads at most ART_UPLOADS_PER_FRAME
+// textures so a burst of thumbnails is spread over several frames
+void art_upload_ready() {
+    texture_cache.frame++;
+
+    int uploads = 0;
+    while (uploads < ART_UPLOADS_PER_FRAME) {
+        pthread_mutex_lock(&art_pipeline.mutex);
+        ArtJob *job = art_pipeline.ready;
+        if (job) {
+            art_pipeline.ready = job->next;
+            if (!art_pipeline.ready) {
+                art_pipeline.ready_tail = NULL;
+            }
+        }
+        pthread_mutex_unlock(&art_pipeline.mutex);
 
-    curl_slist_free_all(headers);
-    curl_easy_cleanup(curl);
+        if (!job) {
+            break;
+        }
 
-    return (res == CURLE_OK && response_code == 204);
-}
+        if (job->now_playing) {
+            if (now_playing_art_land(job)) {
+                uploads++;
+            }
+            art_job_free(job);
+            continue;
+        }
 
-void* network_thread(void *arg) {
-    NetCmdData *cmd = (NetCmdData *)arg;
-    if (!cmd) {
-        printf("Invalid NetCmdData in network_thread\n");
-        return NULL;
-    }
+        // the entry may have been evicted while this was downloading
+        int i = texture_cache_find(job->url, job->size, art_cache_hash(job->url, job->size));
+        ArtSlot *slot = i >= 0 ? &texture_cache.slots[i] : NULL;
+        Image *img = &job->image;
+        if (!slot || slot->state != ART_LOADING) {
+            art_pipeline.dropped++;
+        } else if (img->data && img->width == ART_THUMB_SIZE && img->height == ART_THUMB_SIZE &&
+            img->format == atomic_load(&art_format)) {
+            art_update_rect(texture_cache.atlas, texture_cache_cell(i + 1), img);
+            slot->state = ART_READY;
+            slot->frame = texture_cache.frame;
+            art_pipeline.uploaded++;
+            uploads++;
+        } else {
+            slot->state = ART_FAILED;
+            slot->failed_at = get_current_time();
+        }
 
-    if (strlen(cmd->endpoint) >= sizeof(cmd->endpoint)) {
-        printf("Endpoint URL too long\n");
-        free(cmd);
-        return NULL;
+        art_job_free(job);
     }
+}
 
-    if (strlen(cmd->access_token) >= sizeof(cmd->access_token)) {
-        printf("Access token too long\n");
-        free(cmd);
-        return NULL;
+void texture_cache_clear() {
+    while (texture_cache.lru_head >= 0) {
+        texture_cache_remove(texture_cache.lru_head);
     }
-
-    CURL *curl = curl_easy_init();
-    if (!curl) {
-        printf("Failed to initialize CURL\n");
-        free(cmd);
-        return NULL;
+    if (texture_cache.atlas.id != 0) {
+        UnloadTexture(texture_cache.atlas);
     }
 
-    struct curl_slist *headers = NULL;
-    char auth_header[256];
-    snprintf(auth_header, sizeof(auth_header), "Authorization: Bearer %s", cmd->access_token);
-    headers = curl_slist_append(headers, auth_header);
-    headers = curl_slist_append(headers, "Content-Type: application/json");
-
-    curl_easy_setopt(curl, CURLOPT_URL, cmd->endpoint);
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    // what the textures hold in vram, however many cells were filled
+    int format = atomic_load(&art_format);
+    int atlas_bytes = GetPixelDataSize(THUMB_ATLAS_SIZE, THUMB_ATLAS_SIZE, format);
+    int now_playing_bytes = 2 * GetPixelDataSize(ART_SIZE, ART_SIZE, format);
+    int rgba_bytes = GetPixelDataSize(THUMB_ATLAS_SIZE, THUMB_ATLAS_SIZE, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8) +
+        2 * GetPixelDataSize(ART_SIZE, ART_SIZE, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+    printf("Texture cache: %u hits, %u misses, %u evictions, %d cells\n",
+        texture_cache.hits, texture_cache.misses, texture_cache.evictions, TEXTURE_CACHE_ENTRIES);
+    printf("Art vram: atlas %d KiB + now playing %d KiB (%d KiB as RGBA8)\n",
+        atlas_bytes / 1024, now_playing_bytes / 1024, rgba_bytes / 1024);
+}
 
-    if (cmd->usePost) {
-        curl_easy_setopt(curl, CURLOPT_POST, 1L);
-        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, "");
-    } else {
-        curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "PUT");
+// draws the art, or a placeholder while it is still on its way, both come
+// from the thumbnail atlas so a whole grid is one batch
+void art_draw(const ArtSlot *slot, Rectangle dest) {
+    int cell = 0;
+    if (slot && slot->state == ART_READY) {
+        cell = (int)(slot - texture_cache.slots) + 1;
     }
+    DrawTexturePro(texture_cache.atlas, texture_cache_cell(cell), dest, (Vector2){0, 0}, 0, WHITE);
+}
 
-    long response_code = 0;
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, NULL);
-    CURLcode res = curl_easy_perform(curl);
-    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response_code);
-
-    curl_slist_free_all(headers);
-    curl_easy_cleanup(curl);
-
-    // printf("Network request completed: %s, Response Code: %ld\n", cmd->endpoint, response_code);
-
-    free(cmd);
-    return NULL;
+// draws an icon from the ui atlas, same arguments as DrawTextureEx without rotation
+void draw_icon(Rectangle icon, Vector2 position, float scale, Color tint) {
+    DrawTexturePro(ui_icons.atlas, icon,
+        (Rectangle){position.x, position.y, icon.width * scale, icon.height * scale},
+        (Vector2){0, 0}, 0, tint);
 }
 
+// packs every icon into one texture, shelf by shelf
 bool load_ui() {
-    Image img;
-    img = LoadImage("assets/back.png");
-    ui_textures.back = LoadTextureFromImage(img);
-    UnloadImage(img);
-
-    img = LoadImage("assets/music.png");
-    ui_textures.music = LoadTextureFromImage(img);
-    UnloadImage(img);
-
-    img = LoadImage("assets/home.png");
-    ui_textures.home = LoadTextureFromImage(img);
-    UnloadImage(img);
-
-    img = LoadImage("assets/library.png");
-    ui_textures.library = LoadTextureFromImage(img);
-    UnloadImage(img);
-
-    img = LoadImage("assets/play.png");
-    ui_textures.play = LoadTextureFromImage(img);
-    UnloadImage(img);
-
-    img = LoadImage("assets/pause.png");
-    ui_textures.pause = LoadTextureFromImage(img);
-    UnloadImage(img);
-
-    img = LoadImage("assets/skip.png");
-    ui_textures.skip = LoadTextureFromImage(img);
-    UnloadImage(img);
-
-    img = LoadImage("assets/prev.png");
-    ui_textures.prev = LoadTextureFromImage(img);
-    UnloadImage(img);
+    const char *paths[] = {
+        "assets/back.png", "assets/music.png", "assets/home.png", "assets/library.png",
+        "assets/play.png", "assets/pause.png", "assets/skip.png", "assets/prev.png",
+        "assets/shuffle.png", "assets/like.png"
+    };
+    Rectangle *rects[] = {
+        &ui_icons.back, &ui_icons.music, &ui_icons.home, &ui_icons.library,
+        &ui_icons.play, &ui_icons.pause, &ui_icons.skip, &ui_icons.prev,
+        &ui_icons.shuffle, &ui_icons.like
+    };
+    const int count = sizeof(paths) / sizeof(paths[0]);
+    Image icons[sizeof(paths) / sizeof(paths[0])];
+
+    int x = 0;
+    int y = 0;
+    int shelf = 0;
+    for (int i = 0; i < count; i++) {
+        icons[i] = LoadImage(paths[i]);
+        if (!icons[i].data) {
+            fprintf(stderr, "Failed to load %s\n", paths[i]);
+            for (int j = 0; j < i; j++) {
+                UnloadImage(icons[j]);
+            }
+            return false;
+        }
 
-    img = LoadImage("assets/shuffle.png");
-    ui_textures.shuffle = LoadTextureFromImage(img);
-    UnloadImage(img);
+        // one pixel gap so scaled icons never sample their neighbour
+        if (x + icons[i].width > ICON_ATLAS_WIDTH) {
+            x = 0;
+            y += shelf + 1;
+            shelf = 0;
+        }
+        *rects[i] = (Rectangle){x, y, icons[i].width, icons[i].height};
+        x += icons[i].width + 1;
+        if (icons[i].height > shelf) {
+            shelf = icons[i].height;
+        }
+    }
 
-    img = LoadImage("assets/like.png");
-    ui_textures.like = LoadTextureFromImage(img);
-    UnloadImage(img);
+    Image atlas = GenImageColor(ICON_ATLAS_WIDTH, y + shelf, BLANK);
+    for (int i = 0; i < count; i++) {
+        ImageDraw(&atlas, icons[i], (Rectangle){0, 0, icons[i].width, icons[i].height}, *rects[i], WHITE);
+        UnloadImage(icons[i]);
+    }
+    ui_icons.atlas = LoadTextureFromImage(atlas);
+    UnloadImage(atlas);
 
-    return true;
+    return ui_icons.atlas.id != 0;
 }
 
 void handle_sigint(int sig) {
@@ -719,91 +3235,27 @@ void buttonPressed(int gpio, int level, uint32_t tick) {
 
     if (level == PI_LOW) {
         // printf("Button pressed: GPIO %d\n", gpio);
-        char access_token_copy[256];
-
-        NetCmdData *cmd = malloc(sizeof(NetCmdData));
-        if (!cmd) {
-            printf("Failed to allocate memory for NetCmdData\n");
-            return;
-        }
-
         pthread_mutex_lock(&spclient_mutex);
         bool current_playing = spclient.is_playing;
-        if (strlen(spclient.access_token) >= sizeof(cmd->access_token)) {
-            printf("Access token too long\n");
-            pthread_mutex_unlock(&spclient_mutex);
-            free(cmd);
-            return;
-        }
-        strncpy(access_token_copy, spclient.access_token, sizeof(access_token_copy) - 1);
-        access_token_copy[sizeof(access_token_copy) - 1] = '\0';
-
-        memset(cmd, 0, sizeof(NetCmdData));
-        strncpy(cmd->access_token, access_token_copy, sizeof(cmd->access_token) - 1);
-        cmd->access_token[sizeof(cmd->access_token) - 1] = '\0';
         pthread_mutex_unlock(&spclient_mutex);
 
-        const char* endpoint_url = NULL;
         switch (gpio) {
             case PP_BUTTON:
-                endpoint_url = current_playing ?
-                    "https://api.spotify.com/v1/me/player/pause" :
-                    "https://api.spotify.com/v1/me/player/play";
-                cmd->usePost = false;
+                command_enqueue(current_playing ? CMD_PAUSE : CMD_PLAY, 0, NULL);
                 break;
 
             case SKIP_BUTTON:
-                endpoint_url = "https://api.spotify.com/v1/me/player/next";
-                cmd->usePost = true;
-                refresh_album_art();
-                fetch_current_state(&current_song);
-                // Not loading immediately anymore, testing for root of issues
-                pthread_mutex_lock(&album_art_mutex);
-                if (strlen(current_song.url) > 0) {
-                    strncpy(new_album_art_url, current_song.url, sizeof(new_album_art_url) - 1);
-                    new_album_art_url[sizeof(new_album_art_url) - 1] = '\0';
-                    needs_reload = true;
-                }
-                pthread_mutex_unlock(&album_art_mutex);
+                command_enqueue(CMD_NEXT, 0, NULL);
                 break;
 
             case BACK_BUTTON:
-                endpoint_url = "https://api.spotify.com/v1/me/player/previous";
-                cmd->usePost = true;
-                refresh_album_art();
-                fetch_current_state(&current_song);
-                // Not loading immediately anymore, testing for root of issues
-                pthread_mutex_lock(&album_art_mutex);
-                if (strlen(current_song.url) > 0) {
-                    strncpy(new_album_art_url, current_song.url, sizeof(new_album_art_url) - 1);
-                    new_album_art_url[sizeof(new_album_art_url) - 1] = '\0';
-                    needs_reload = true;
-                }
-                pthread_mutex_unlock(&album_art_mutex);
+                command_enqueue(CMD_PREVIOUS, 0, NULL);
                 break;
 
             default:
                 printf("Unknown GPIO: %d\n", gpio);
-                free(cmd);
                 break;
         }
-
-        if (strlen(endpoint_url) >= sizeof(cmd->endpoint)) {
-            printf("Endpoint URL too long\n");
-            free(cmd);
-            return;
-        }
-        strncpy(cmd->endpoint, endpoint_url, sizeof(cmd->endpoint) - 1);
-        cmd->endpoint[sizeof(cmd->endpoint) - 1] = '\0';
-        // printf("Endpoint: %s\n", cmd->endpoint);
-
-        pthread_t net_thread;
-        if (pthread_create(&net_thread, NULL, network_thread, cmd) == 0) {
-            pthread_detach(net_thread);
-        } else {
-            printf("Failed to create network thread\n");
-            free(cmd);
-        }
     }
 }
 
@@ -813,11 +3265,77 @@ void display_volume(int target) {
         "", &target_f, 0, 100);
 }
 
-uint64_t get_current_time() {
-    struct timespec ts;
-    clock_gettime(CLOCK_MONOTONIC, &ts);
+// renews the access token ahead of expiry so no request ever carries a dead one,
+// the old token stays valid for anything already in flight
+void* token_refresh_thread(void *arg) {
+    uint64_t next_attempt = 0;
 
-    return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+    while (running) {
+        usleep(STATE_POLL_SLICE_MS * 1000 * 4);
+        if (!logged_in) {
+            continue;
+        }
+
+        char form[1024];
+        pthread_mutex_lock(&spclient_mutex);
+        uint64_t expiry = spclient.expiry;
+        snprintf(form, sizeof(form),
+            "grant_type=refresh_token&"
+            "refresh_token=%s&"
+            "client_id=%s&"
+            "client_secret=%s",
+            spclient.refresh_token, spclient.client_id, spclient.client_secret);
+        pthread_mutex_unlock(&spclient_mutex);
+
+        uint64_t now = get_current_time();
+        bool forced = atomic_load(&token_refresh_requested);
+        if (now < next_attempt || (!forced && now + TOKEN_REFRESH_MARGIN_MS < expiry)) {
+            continue;
+        }
+
+        atomic_store(&token_refresh_requested, false);
+        if (token_request(form)) {
+            next_attempt = 0;
+        } else {
+            fprintf(stderr, "Access token refresh failed, retrying in %ds\n", TOKEN_RETRY_MS / 1000);
+            next_attempt = now + TOKEN_RETRY_MS;
+        }
+    }
+
+    return NULL;
+}
+
+void* state_poller_thread(void *arg) {
+    uint64_t last_poll = 0;
+
+    while (running) {
+        bool forced = atomic_exchange(&state_refresh_requested, false);
+        if (!logged_in || (!forced && get_current_time() - last_poll < rate_poll_interval())) {
+            usleep(STATE_POLL_SLICE_MS * 1000);
+            continue;
+        }
+
+        PlayerSnapshot snap = {0};
+        snap.has_playback = fetch_current_state(&snap.song);
+        snap.fetched_at = get_current_time();
+
+        // a 429 says nothing about playback, keep showing the last good state
+        if (!snap.has_playback && rate_limited()) {
+            last_poll = snap.fetched_at;
+            continue;
+        }
+
+        pthread_mutex_lock(&spclient_mutex);
+        snprintf(snap.track_id, sizeof(snap.track_id), "%s", spclient.current_track_id);
+        snap.is_playing = spclient.is_playing;
+        snap.shuffle = spclient.shuffle;
+        pthread_mutex_unlock(&spclient_mutex);
+
+        publish_player_state(&snap);
+        last_poll = snap.fetched_at;
+    }
+
+    return NULL;
 }
 
 void* gpio_thread_func(void* arg) {
@@ -870,18 +3388,9 @@ void* gpio_thread_func(void* arg) {
             pthread_mutex_unlock(&volume_mutex);
         }
 
-        char endpoint[256];
-        char access_token_copy[256];
         if (target != -1 && (get_current_time() - volume_change) >= 250 &&
             target != prev_target) {
-            snprintf(endpoint, sizeof(endpoint), 
-                "https://api.spotify.com/v1/me/player/volume?volume_percent=%d", target);
-            pthread_mutex_lock(&spclient_mutex);
-            snprintf(access_token_copy, sizeof(access_token_copy), spclient.access_token);
-            pthread_mutex_unlock(&spclient_mutex);
-            
-            if (spotify_request(endpoint, access_token_copy, NULL)) {
-                display_volume(target);
+            if (command_enqueue(CMD_VOLUME, target, NULL)) {
                 prev_target = target;
             }
             target = -1;
@@ -906,73 +3415,27 @@ AppState display_qr(AppState current_state) {
     pthread_mutex_lock(&logged_in_mutex);
     if (logged_in) {
         current_state = STATE_APP_HOME;
-    }
-    pthread_mutex_unlock(&logged_in_mutex);
-
-    return current_state;
-}
-
-void truncate_text(char *output, const char *input, int max_width, int fontsize) {
-    size_t length = strlen(input);
-    char temp[128];
-    if (MeasureText(input, fontsize) <= max_width) {
-        snprintf(output, sizeof(temp), "%s", input);
-        return;
-    }
-
-    for (size_t i = length - 1; i > 0; i--) {
-        snprintf(temp, i, "%s", input);
-        if (MeasureText(temp, fontsize) <= max_width) {
-            snprintf(output, sizeof(temp), "%s..", temp);
-            return;
-        }
-    }
-}
-
-cJSON* spotify_get(const char *endpoint_base, const char *access_token) {
-    CURL *curl = curl_easy_init();
-    if (!curl) {
-        return NULL;
-    }
-
-    MemoryBuffer region = {
-        malloc(1),
-        0
-    };
-
-    char auth_header[512];
-    snprintf(auth_header, sizeof(auth_header), "Authorization: Bearer %s", access_token);
-    
-    struct curl_slist *headers = NULL;
-    headers = curl_slist_append(headers, auth_header);
-    headers = curl_slist_append(headers, "Content-Type: application/json");
-
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-    curl_easy_setopt(curl, CURLOPT_URL, endpoint_base);
-    curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &region);
-        
-    CURLcode res = curl_easy_perform(curl);
-    long http_code = 0;
-    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
-    curl_slist_free_all(headers);
-    curl_easy_cleanup(curl);
+    }
+    pthread_mutex_unlock(&logged_in_mutex);
 
-    if (res != CURLE_OK || region.memory == 0) {
-        fprintf(stderr, "CURL error: %s\n", curl_easy_strerror(res));
-        free(region.memory);
-        return NULL;
+    return current_state;
+}
+
+void truncate_text(char *output, const char *input, int max_width, int fontsize) {
+    size_t length = strlen(input);
+    char temp[128];
+    if (MeasureText(input, fontsize) <= max_width) {
+        snprintf(output, sizeof(temp), "%s", input);
+        return;
     }
 
-    // fprintf(stderr, "Response from %s (HTTP %ld): %s\n", endpoint_base, http_code, region.memory);
-    cJSON *json = cJSON_Parse(region.memory);
-    if (!json) {
-        fprintf(stderr, "JSON parse error for %s: %s\n", 
-            endpoint_base, cJSON_GetErrorPtr());
+    for (size_t i = length - 1; i > 0; i--) {
+        snprintf(temp, i, "%s", input);
+        if (MeasureText(temp, fontsize) <= max_width) {
+            snprintf(output, sizeof(temp), "%s..", temp);
+            return;
+        }
     }
-    free(region.memory);
-    return json;
 }
 
 /*
@@ -998,34 +3461,220 @@ void reset_fetch() {
     fetching = false;
 }
 
-void* fetch_user(void *arg) {
-    char endpoint[256];
-    char access_token_copy[256];
-    pthread_mutex_lock(&spclient_mutex);
-    snprintf(endpoint, sizeof(endpoint), "https://api.spotify.com/v1/me");
-    snprintf(access_token_copy, sizeof(access_token_copy), "%s", spclient.access_token);
-    pthread_mutex_unlock(&spclient_mutex);
+static uint32_t string_hash(const char *str) {
+    uint32_t hash = 2166136261u;
+    for (const char *c = str; *c; c++) {
+        hash = (hash ^ (unsigned char)*c) * 16777619u;
+    }
+    return hash;
+}
 
-    // fprintf(stderr, "Calling /me endpoint with token: %s\n", access_token_copy);
+bool string_pool_init(StringPool *pool, uint32_t capacity) {
+    *pool = (StringPool){0};
+    pool->data = malloc(capacity);
+    pool->slot_count = 64;
+    pool->slots = calloc(pool->slot_count, sizeof(uint32_t));
+    if (!pool->data || !pool->slots) {
+        free(pool->data);
+        free(pool->slots);
+        *pool = (StringPool){0};
+        return false;
+    }
 
-    cJSON *json = spotify_get(endpoint, access_token_copy);
-    if (!json) {
-        fprintf(stderr, "Failed to fetch user info\n");
-        reset_fetch();
-        return NULL;
+    pool->data[0] = '\0';
+    pool->used = 1;
+    pool->capacity = capacity;
+    return true;
+}
+
+void string_pool_free(StringPool *pool) {
+    free(pool->data);
+    free(pool->slots);
+    *pool = (StringPool){0};
+}
+
+static const char *string_get(const StringPool *pool, StrRef ref) {
+    return pool->data ? pool->data + ref : "";
+}
+
+static bool string_pool_rehash(StringPool *pool) {
+    uint32_t slot_count = pool->slot_count * 2;
+    uint32_t *slots = calloc(slot_count, sizeof(uint32_t));
+    if (!slots) {
+        return false;
     }
 
-    cJSON *error = cJSON_GetObjectItem(json, "error");
-    if (error) {
-        fprintf(stderr, "API error fetching user: %s\n",
-            cJSON_GetStringValue(cJSON_GetObjectItem(error, "message")));
-        cJSON_Delete(json);
+    for (uint32_t i = 0; i < pool->slot_count; i++) {
+        uint32_t ref = pool->slots[i];
+        if (ref) {
+            uint32_t j = string_hash(pool->data + ref) & (slot_count - 1);
+            while (slots[j]) {
+                j = (j + 1) & (slot_count - 1);
+            }
+            slots[j] = ref;
+        }
+    }
+    free(pool->slots);
+    pool->slots = slots;
+    pool->slot_count = slot_count;
+    return true;
+}
+
+// the same name or url only takes space once per response, NULL, "" and
+// allocation failures all come back as the empty string
+StrRef string_intern(StringPool *pool, const char *str) {
+    if (!pool->data || !str || !str[0]) {
+        return 0;
+    }
+    if ((pool->count + 1) * 2 > pool->slot_count && !string_pool_rehash(pool)) {
+        return 0;
+    }
+
+    uint32_t i = string_hash(str) & (pool->slot_count - 1);
+    while (pool->slots[i]) {
+        if (strcmp(pool->data + pool->slots[i], str) == 0) {
+            return pool->slots[i];
+        }
+        i = (i + 1) & (pool->slot_count - 1);
+    }
+
+    size_t len = strlen(str) + 1;
+    if (pool->used + len > pool->capacity) {
+        size_t capacity = pool->capacity;
+        while (pool->used + len > capacity) {
+            capacity *= 2;
+        }
+        if (capacity > UINT32_MAX) {
+            return 0;
+        }
+        char *data = realloc(pool->data, capacity);
+        if (!data) {
+            return 0;
+        }
+        pool->data = data;
+        pool->capacity = capacity;
+    }
+
+    StrRef ref = pool->used;
+    memcpy(pool->data + ref, str, len);
+    pool->used += len;
+    pool->slots[i] = ref;
+    pool->count++;
+    return ref;
+}
+
+static bool copy_spotify_id(char *dst, size_t len, const char *id) {
+    if (!id || strlen(id) >= len) {
+        return false;
+    }
+    memcpy(dst, id, strlen(id) + 1);
+    return true;
+}
+
+void playlist_list_free(PlaylistList *list) {
+    free(list->items);
+    string_pool_free(&list->strings);
+    *list = (PlaylistList){0};
+}
+
+// decodes one page of /users/{id}/playlists, false if it has no items array
+bool playlist_list_decode(const cJSON *json, PlaylistList *out) {
+    const cJSON *items = cJSON_GetObjectItemCaseSensitive(json, "items");
+    if (!cJSON_IsArray(items)) {
+        return false;
+    }
+
+    int count = cJSON_GetArraySize(items);
+    *out = (PlaylistList){0};
+    out->items = calloc(count > 0 ? count : 1, sizeof(Playlist));
+    if (!out->items || !string_pool_init(&out->strings, STRING_POOL_INITIAL)) {
+        playlist_list_free(out);
+        return false;
+    }
+
+    const cJSON *item = NULL;
+    cJSON_ArrayForEach(item, items) {
+        Playlist *playlist = &out->items[out->count];
+        if (!copy_spotify_id(playlist->id, sizeof(playlist->id),
+            cJSON_GetStringValue(cJSON_GetObjectItemCaseSensitive(item, "id")))) {
+            continue;
+        }
+        playlist->name = string_intern(&out->strings,
+            cJSON_GetStringValue(cJSON_GetObjectItemCaseSensitive(item, "name")));
+
+        const cJSON *total = cJSON_GetObjectItemCaseSensitive(cJSON_GetObjectItemCaseSensitive(item, "tracks"), "total");
+        playlist->track_count = cJSON_IsNumber(total) ? total->valueint : 0;
+
+        // a 100px thumbnail only needs the 300px image, not the 640px one
+        ImageVariant variants[ART_VARIANTS] = {0};
+        int variant_count = 0;
+        const cJSON *image = NULL;
+        cJSON_ArrayForEach(image, cJSON_GetObjectItemCaseSensitive(item, "images")) {
+            if (variant_count == ART_VARIANTS) {
+                break;
+            }
+            const char *url = cJSON_GetStringValue(cJSON_GetObjectItemCaseSensitive(image, "url"));
+            const cJSON *width = cJSON_GetObjectItemCaseSensitive(image, "width");
+            if (url) {
+                copy_field(variants[variant_count].url, sizeof(variants[variant_count].url), url);
+                variants[variant_count].width = cJSON_IsNumber(width) ? width->valueint : 0;
+                variant_count++;
+            }
+        }
+        playlist->image_url = string_intern(&out->strings,
+            art_pick_variant(variants, variant_count, ART_THUMB_SIZE));
+        out->count++;
+    }
+
+    return true;
+}
+
+void track_list_free(TrackList *list) {
+    free(list->items);
+    string_pool_free(&list->strings);
+    *list = (TrackList){0};
+}
+
+// decodes the items of a /playlists/{id}/tracks page, entries without a
+// track (removed or unavailable ones come back as null) are left out
+bool track_list_decode(const cJSON *json, TrackList *out) {
+    const cJSON *items = cJSON_GetObjectItemCaseSensitive(json, "items");
+    if (!cJSON_IsArray(items)) {
+        return false;
+    }
+
+    int count = cJSON_GetArraySize(items);
+    *out = (TrackList){0};
+    out->items = calloc(count > 0 ? count : 1, sizeof(Track));
+    if (!out->items || !string_pool_init(&out->strings, STRING_POOL_INITIAL)) {
+        track_list_free(out);
+        return false;
+    }
+
+    const cJSON *item = NULL;
+    cJSON_ArrayForEach(item, items) {
+        const cJSON *track = cJSON_GetObjectItemCaseSensitive(item, "track");
+        Track *decoded = &out->items[out->count];
+        decoded->uri = string_intern(&out->strings,
+            cJSON_GetStringValue(cJSON_GetObjectItemCaseSensitive(track, "uri")));
+        if (decoded->uri) {
+            out->count++;
+        }
+    }
+
+    return true;
+}
+
+void on_user_fetched(HttpRequest *req) {
+    cJSON *json = http_response_json(req);
+    if (!json) {
+        fprintf(stderr, "Failed to fetch user info\n");
         reset_fetch();
-        return NULL;
+        return;
     }
 
     pthread_mutex_lock(&spclient_mutex);
-    cJSON *name = cJSON_GetObjectItem(json, "id");
+    cJSON *name = cJSON_GetObjectItemCaseSensitive(json, "id");
     if (cJSON_IsString(name)) {
         snprintf(spclient.client_name, sizeof(spclient.client_name), "%s", name->valuestring);
         // fprintf(stderr, "username: %s\n", spclient.client_name);
@@ -1034,112 +3683,98 @@ void* fetch_user(void *arg) {
 
     cJSON_Delete(json);
     reset_fetch();
-    return NULL;
 }
 
-void* fetch_playlists(void *arg) {
-    PlaylistArgs *args = (PlaylistArgs *) arg;
-    int limit = args->limit;
-    int offset = args->offset;
+bool fetch_user() {
+    HttpRequest *req = http_request_new(PRIO_BROWSE, "GET", "https://api.spotify.com/v1/me", NULL);
+    if (!req) {
+        return false;
+    }
 
-    char endpoint[256];
-    char access_token_copy[256];
-    pthread_mutex_lock(&spclient_mutex);
-    snprintf(endpoint, sizeof(endpoint), "https://api.spotify.com/v1/users/%s/playlists?limit=%d&offset=%d", 
-        spclient.client_name, limit, offset);
-    snprintf(access_token_copy, sizeof(access_token_copy), "%s", spclient.access_token);
-    pthread_mutex_unlock(&spclient_mutex);
+    req->on_complete = on_user_fetched;
+    return http_submit(req);
+}
 
-    cJSON *json = spotify_get(endpoint, access_token_copy);
+void on_playlists_fetched(HttpRequest *req) {
+    cJSON *json = http_response_json(req);
     if (!json) {
         fprintf(stderr, "Failed to get playlists from Spotify API\n");
         reset_fetch();
-        free(args);
-        return NULL;
+        return;
     }
 
-    cJSON *error = cJSON_GetObjectItem(json, "error");
-    if (error) {
-        fprintf(stderr, "Spotify API error: %s\n", 
-            cJSON_GetStringValue(cJSON_GetObjectItem(error, "message")));
-        cJSON_Delete(json);
+    PlaylistList playlists;
+    bool decoded = playlist_list_decode(json, &playlists);
+    cJSON_Delete(json);
+    if (!decoded) {
+        fprintf(stderr, "Unexpected playlists response from Spotify API\n");
         reset_fetch();
-        free(args);
-        return NULL;
-    }   
+        return;
+    }
 
     pthread_mutex_lock(&spclient_mutex);
-    if (spclient.playlists) {
-        cJSON_Delete(spclient.playlists);
-    }
-    spclient.playlists = cJSON_Duplicate(json, true);
-    /*
-    cJSON *items = cJSON_GetObjectItem(json, "items");
-    if (items) {
-        fprintf(stderr, "Fetched %d playlists\n", cJSON_GetArraySize(items));
-    }
-    */
+    playlist_list_free(&spclient.playlists);
+    spclient.playlists = playlists;
+    // fprintf(stderr, "Fetched %d playlists\n", playlists.count);
     pthread_mutex_unlock(&spclient_mutex);
 
-    cJSON_Delete(json);
     reset_fetch();
-    free(args);
-    return NULL;
 }
 
-void* play_random_from_playlist(void *arg) {
-    char playlist_id[256];
-    char access_token[256];
-    
+bool fetch_playlists(int limit, int offset) {
+    char endpoint[512];
     pthread_mutex_lock(&spclient_mutex);
-    snprintf(playlist_id, sizeof(playlist_id), spclient.current_playlist_id);
-    snprintf(access_token, sizeof(access_token), spclient.access_token);
+    snprintf(endpoint, sizeof(endpoint), "https://api.spotify.com/v1/users/%s/playlists?limit=%d&offset=%d", 
+        spclient.client_name, limit, offset);
     pthread_mutex_unlock(&spclient_mutex);
-    
-    char endpoint[512];
-    snprintf(endpoint, sizeof(endpoint), 
-        "https://api.spotify.com/v1/playlists/%s/tracks", 
-        playlist_id);
-    
-    cJSON *response = spotify_get(endpoint, access_token);
+
+    HttpRequest *req = http_request_new(PRIO_BROWSE, "GET", endpoint, NULL);
+    if (!req) {
+        return false;
+    }
+
+    req->on_complete = on_playlists_fetched;
+    return http_submit(req);
+}
+
+void on_playlist_tracks_fetched(HttpRequest *req) {
+    cJSON *response = http_response_json(req);
     if (!response) {
-        return NULL;
+        return;
     }
     
-    cJSON *items = cJSON_GetObjectItem(response, "items");
-    int track_count = cJSON_GetArraySize(items);
-    if (track_count > 0) {
-        int random_index = rand() % track_count;
-        cJSON *track_item = cJSON_GetArrayItem(items, random_index);
-        cJSON *track = cJSON_GetObjectItem(track_item, "track");
-        if (!track) {
-            cJSON_Delete(response);
-            return NULL;
-        }
-
-        cJSON *track_uri = cJSON_GetObjectItem(track, "uri");
-        if (!track_uri || !track_uri->valuestring) {
-            cJSON_Delete(response);
-            return NULL;
-        }
-        
-        char playback_endpoint[512];
-        pthread_mutex_lock(&spclient_mutex);
-        snprintf(playback_endpoint, sizeof(playback_endpoint),
-            "https://api.spotify.com/v1/me/player/play%s%s",
-            spclient.current_playing_id[0] ? "?device_id=" : "",
-            spclient.current_playing_id);
-        pthread_mutex_unlock(&spclient_mutex);
-        
-        char payload[512];
-        snprintf(payload, sizeof(payload),
-            "{\"uris\":[\"%s\"]}", track_uri->valuestring);
-        
-        spotify_request(playback_endpoint, access_token, payload);
+    TrackList tracks;
+    bool decoded = track_list_decode(response, &tracks);
+    cJSON_Delete(response);
+    if (!decoded) {
+        return;
+    }
+
+    if (tracks.count > 0) {
+        const Track *track = &tracks.items[rand() % tracks.count];
+        command_enqueue(CMD_PLAY, 0, string_get(&tracks.strings, track->uri));
     }
+    track_list_free(&tracks);
+}
+
+bool play_random_from_playlist() {
+    char endpoint[512];
+    pthread_mutex_lock(&spclient_mutex);
+    // only the track uris are used, so that's all we ask for
+    snprintf(endpoint, sizeof(endpoint), 
+        "https://api.spotify.com/v1/playlists/%s/tracks"
+        "?market=from_token&limit=100&fields=total,items(track(uri))", 
+        spclient.current_playlist_id);
+    pthread_mutex_unlock(&spclient_mutex);
     
-    cJSON_Delete(response);
-    return NULL;
+    // the user tapped a playlist and is waiting on this one
+    HttpRequest *req = http_request_new(PRIO_INTERACTIVE, "GET", endpoint, NULL);
+    if (!req) {
+        return false;
+    }
+
+    req->on_complete = on_playlist_tracks_fetched;
+    return http_submit(req);
 }
 
 static ControlsRegion controls = {
@@ -1167,10 +3802,19 @@ void display_top_nav(bool is_home) {
     // int home_length = MeasureText("Home", 22);
     // int library_length = MeasureText("Library", 22);
 
-    DrawTextureEx(ui_textures.home, (Vector2){controls.home.x, controls.home.y}, 0.0f,
+    // icons first and text after, so the icons go out as one batch
+    draw_icon(ui_icons.home, (Vector2){controls.home.x, controls.home.y}, 
         controls.home_pressed ? 0.9f : 1.0f, (is_home && controls.home_pressed ? 
         DARKGRAY : (is_home ? WHITE : GRAY))
     );
+    draw_icon(ui_icons.library, (Vector2){controls.library.x, controls.library.y}, 
+        controls.library_pressed ? 0.9f : 1.0f, (!is_home && controls.library_pressed ? 
+        DARKGRAY : (!is_home ? WHITE : GRAY))
+    );
+    draw_icon(ui_icons.music, (Vector2){controls.music.x, controls.music.y}, 
+        controls.music_pressed ? 0.45f : 0.5f, controls.music_pressed ? WHITE : GRAY
+    );
+
     DrawText("Home", PADDING + 32 + 10, PADDING + 12, 22, (is_home && controls.home_pressed ? 
         DARKGRAY : (is_home ? WHITE : GRAY))
     );
@@ -1178,70 +3822,34 @@ void display_top_nav(bool is_home) {
     // this makes the text be "clickable" with the icon
     // printf("Home length: %d\n", home_length);
 
-    DrawTextureEx(ui_textures.library, (Vector2){controls.library.x, controls.library.y}, 0.0f,
-        controls.library_pressed ? 0.9f : 1.0f, (!is_home && controls.library_pressed ? 
-        DARKGRAY : (!is_home ? WHITE : GRAY))
-    );
     DrawText("Library", 3 * PADDING + 2 * 32 + 10, PADDING + 12, 22, (!is_home && controls.library_pressed ? 
         DARKGRAY : (!is_home ? WHITE : GRAY))
     );
     // adding length of this number to the controls region for controls.library
     // this makes the text be "clickable" with the icon
     // printf("Library length: %d\n", library_length);
-
-    DrawTextureEx(ui_textures.music, (Vector2){controls.music.x, controls.music.y}, 0.0f, 
-        controls.music_pressed ? 0.45f : 0.5f, controls.music_pressed ? WHITE : GRAY
-    );
-
 }
 
-void display_playlist(cJSON *playlist, Vector2 position) {
-    cJSON *name = cJSON_GetObjectItem(playlist, "name");
-    cJSON *images = cJSON_GetObjectItem(playlist, "images");
-    cJSON *id = cJSON_GetObjectItem(playlist, "id");
-
-    if (!id || !id->valuestring) {
-        return;
-    }
-    
-    Texture2D *playlist_texture = NULL;
-    for (int i = 0; i < texture_count; i++) {
-        if (strcmp(playlist_textures[i].id, id->valuestring) == 0) {
-            playlist_texture = &playlist_textures[i].texture;
-            break;
-        }
-    }
+// the grid is drawn in two passes, every thumbnail first (one batch off the
+// atlas) and then the frames, names and clicks
+void display_playlist_art(const PlaylistList *list, const Playlist *playlist, Vector2 position) {
+    const char *url = string_get(&list->strings, playlist->image_url);
+    const ArtSlot *art = url[0] ? art_get(url, ART_THUMB_SIZE, PRIO_BROWSE) : NULL;
+    art_draw(art, (Rectangle){position.x + 10, position.y + 10, PLAYLIST_WIDTH - 20, 
+        PLAYLIST_HEIGHT - 60});
+}
 
-    if (!playlist_texture && texture_count < MAX_PLAYLISTS) {
-        if (images && cJSON_GetArraySize(images) > 0) {
-            cJSON *image = cJSON_GetArrayItem(images, 0);
-            cJSON *url = cJSON_GetObjectItem(image, "url");
-            if (url && url->valuestring) {
-                snprintf(playlist_textures[texture_count].id, 
-                    sizeof(playlist_textures[texture_count].id), id->valuestring);
-                playlist_textures[texture_count].texture = load_album_art(url->valuestring);
-                playlist_texture = &playlist_textures[texture_count].texture;
-                texture_count++;
-            }
-        }
-    }
-    
+void display_playlist(const PlaylistList *list, const Playlist *playlist, Vector2 position) {
     DrawRectangleLines(position.x, position.y, PLAYLIST_WIDTH, 
         PLAYLIST_HEIGHT, GRAY);
-    if (playlist_texture && playlist_texture->id != 0) {
-        DrawTexturePro(*playlist_texture,
-            (Rectangle){0, 0, playlist_texture->width, playlist_texture->height},
-            (Rectangle){position.x + 10, position.y + 10, PLAYLIST_WIDTH - 20, 
-            PLAYLIST_HEIGHT - 60},
-            (Vector2){0, 0}, 0, WHITE);
-    }
     
-    if (name && name->valuestring) {
+    const char *name = string_get(&list->strings, playlist->name);
+    if (name[0]) {
         char display_name[32];
-        truncate_text(display_name, name->valuestring, PLAYLIST_WIDTH - 20, 20);
+        truncate_text(display_name, name, PLAYLIST_WIDTH - 20, 20);
         DrawText(display_name, position.x + 10, position.y + PLAYLIST_HEIGHT - 40, 
             20, WHITE);
-        // printf("%s\n", name->valuestring);
+        // printf("%s\n", name);
     }
     
     Vector2 mouse_pos = GetMousePosition();
@@ -1249,11 +3857,9 @@ void display_playlist(cJSON *playlist, Vector2 position) {
         PLAYLIST_WIDTH, PLAYLIST_HEIGHT})) {
         if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) {
             pthread_mutex_lock(&spclient_mutex);
-            strncpy(spclient.current_playlist_id, id->valuestring, sizeof(spclient.current_playlist_id));
+            copy_field(spclient.current_playlist_id, sizeof(spclient.current_playlist_id), playlist->id);
             pthread_mutex_unlock(&spclient_mutex);
-            pthread_t play_thread;
-            pthread_create(&play_thread, NULL, play_random_from_playlist, NULL);
-            pthread_detach(play_thread);
+            play_random_from_playlist();
         }
     }
 }
@@ -1268,17 +3874,16 @@ AppState display_home(AppState current_state) {
 
     if (!initialized) {
         pthread_mutex_lock(&spclient_mutex);
-        if (!spclient.client_name[0] && !fetching) {
+        bool have_user = spclient.client_name[0] != '\0';
+        pthread_mutex_unlock(&spclient_mutex);
+
+        if (!have_user && !fetching) {
             fetching = true;
-            pthread_t fetch_thread;
-            if (pthread_create(&fetch_thread, NULL, fetch_user, NULL) != 0) {
-                fprintf(stderr, "Failed to create user fetch thread\n");
+            if (!fetch_user()) {
+                fprintf(stderr, "Failed to start user fetch\n");
                 fetching = false;
-            } else {
-                pthread_detach(fetch_thread);
             }
         }
-        pthread_mutex_unlock(&spclient_mutex);
         initialized = true;
     }
 
@@ -1292,30 +3897,22 @@ AppState display_home(AppState current_state) {
     if (spclient.client_name[0] && !user_fetched) {
         user_fetched = true;
     }
+    pthread_mutex_unlock(&spclient_mutex);
 
-    if (user_fetched && !playlists_fetched && !fetching && !cached_playlists) {
+    // request helpers take spclient_mutex themselves
+    if (user_fetched && !playlists_fetched && !fetching && !home_playlists.items) {
         fetching = true;
-        PlaylistArgs *args = malloc(sizeof(PlaylistArgs));
-        if (args) {
-            args->limit = 5;
-            args->offset = 0;
-
-            pthread_t fetch_thread;
-            if (pthread_create(&fetch_thread, NULL, fetch_playlists, args) != 0) {
-                fprintf(stderr, "Failed to create fetch thread\n");
-                free(args);
-                fetching = false;
-            } else {
-                pthread_detach(fetch_thread);
-            }
-        } else {
-            fprintf(stderr, "Failed to allocate memory for fetch arguments\n");
+        if (!fetch_playlists(5, 0)) {
+            fprintf(stderr, "Failed to start playlist fetch\n");
             fetching = false;
         }
     }
 
-    if (spclient.playlists && !cached_playlists) {
-        cached_playlists = cJSON_Duplicate(spclient.playlists, true);
+    // decoded once by the fetch, the grid then owns it and draws without the lock
+    pthread_mutex_lock(&spclient_mutex);
+    if (spclient.playlists.items && !home_playlists.items) {
+        home_playlists = spclient.playlists;
+        spclient.playlists = (PlaylistList){0};
         playlists_fetched = true;
     }
     pthread_mutex_unlock(&spclient_mutex);
@@ -1347,16 +3944,18 @@ AppState display_home(AppState current_state) {
         }
     }
 
-    if (cached_playlists) {
-        cJSON *items = cJSON_GetObjectItem(cached_playlists, "items");
-        if (items) {
-            int item_count = cJSON_GetArraySize(items);
+    if (home_playlists.items) {
+        for (int pass = 0; pass < 2; pass++) {
             int x = PADDING;
             int y = 100;
             
-            for (int i = 0; i < item_count; i++) {
-                cJSON *playlist = cJSON_GetArrayItem(items, i);
-                display_playlist(playlist, (Vector2){x, y});
+            for (int i = 0; i < home_playlists.count; i++) {
+                const Playlist *playlist = &home_playlists.items[i];
+                if (pass == 0) {
+                    display_playlist_art(&home_playlists, playlist, (Vector2){x, y});
+                } else {
+                    display_playlist(&home_playlists, playlist, (Vector2){x, y});
+                }
 
                 x += PLAYLIST_WIDTH + PADDING / 2;
                 if (x + PLAYLIST_WIDTH > SCREEN_WIDTH) {
@@ -1408,22 +4007,12 @@ AppState display_library(AppState current_state) {
 AppState display_app(AppState current_state) {
     DrawRectangle(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT - 100, Fade(BLACK, 0.7f));
 
-    pthread_mutex_lock(&album_art_mutex);
-    if (needs_reload) {
-        if (strlen(new_album_art_url) > 0) {
-            if (albumTexture.id != 0) UnloadTexture(albumTexture);
-            albumTexture = load_album_art(new_album_art_url);
-            new_album_art_url[0] = '\0';
-        }
-
-        needs_reload = false;
-    }
-    pthread_mutex_unlock(&album_art_mutex);
-
-    static SongInfo cached_song = {0};
+    // optimistic toggles, dropped once a snapshot newer than the press arrives
     static bool cached_is_playing = false;
     static bool cached_is_shuffle = false;
     static bool cached_is_liked = false;
+    static uint64_t playing_override_at = 0;
+    static uint64_t shuffle_override_at = 0;
 
     Vector2 mouse_pos = GetMousePosition();
     bool clicked = IsMouseButtonPressed(MOUSE_LEFT_BUTTON);
@@ -1435,17 +4024,29 @@ AppState display_app(AppState current_state) {
         tapped = true;
     }
 
-    bool hasPlayback = fetch_current_state(&current_song);
-    static char prev_song_id[256] = {0};
-    bool should_refresh = false;
+    PlayerSnapshot snap;
+    read_player_state(&snap);
+    SongInfo *song = &snap.song;
+
+    bool hasPlayback = snap.has_playback;
 
     if (hasPlayback) {
-        pthread_mutex_lock(&spclient_mutex);
-        char current_track_id[256];
-        strncpy(current_track_id, spclient.current_track_id, sizeof(current_track_id) - 1);
-        current_track_id[sizeof(current_track_id) - 1] = '\0';
-        cached_is_playing = spclient.is_playing;
-        pthread_mutex_unlock(&spclient_mutex);
+        if (snap.fetched_at >= playing_override_at) {
+            cached_is_playing = snap.is_playing;
+            playing_override_at = 0;
+        }
+        if (snap.fetched_at >= shuffle_override_at) {
+            cached_is_shuffle = snap.shuffle;
+            shuffle_override_at = 0;
+        }
+
+        // progress only moves on poll, fill the gap locally while playing
+        if (snap.is_playing && song->duration > 0) {
+            song->progress += (int)((get_current_time() - snap.fetched_at) / 1000);
+            if (song->progress > song->duration) {
+                song->progress = song->duration;
+            }
+        }
 
         pthread_mutex_lock(&volume_mutex);
         int current_vol = display_vol;
@@ -1456,66 +4057,57 @@ AppState display_app(AppState current_state) {
             display_volume(current_vol);
         }
 
-        if (strcmp(current_track_id, prev_song_id) != 0) {
-            refresh_album_art();
-            strncpy(prev_song_id, current_track_id, sizeof(prev_song_id) - 1);
-            prev_song_id[sizeof(prev_song_id) - 1] = '\0';
-
-            if (strlen(current_song.url) > 0) {
-                albumTexture = load_album_art(current_song.url);
-            }
-        }
-
-        if (strlen(current_song.url) > 0 && albumTexture.id == 0) {
-            albumTexture = load_album_art(current_song.url);
-        }
-
-        if (albumTexture.id != 0) {
-            DrawTexture(albumTexture, PADDING, ((SCREEN_HEIGHT - albumTexture.height) / 2) - PADDING, WHITE);
+        // flipping back to a recent track is a disk cache hit, mapped again and uploaded into the back texture
+        now_playing_art_request(song->images, song->image_count);
+        Rectangle art_rect = {PADDING, ((SCREEN_HEIGHT - ART_SIZE) / 2) - PADDING, ART_SIZE, ART_SIZE};
+        if (now_playing_art.shown) {
+            DrawTexture(now_playing_art.textures[now_playing_art.front], art_rect.x, art_rect.y, WHITE);
+        } else {
+            art_draw(NULL, art_rect);
         }
 
         char title_text[128];
         char artist_text[128];
-        truncate_text(title_text, current_song.title, 400, 44);
-        // snprintf(title_text, sizeof(title_text), "%s", current_song.title);
-        DrawText(title_text, (2 * PADDING) + albumTexture.width, 70, 44, WHITE);
+        truncate_text(title_text, song->title, 400, 44);
+        // snprintf(title_text, sizeof(title_text), "%s", song->title);
+        DrawText(title_text, (2 * PADDING) + ART_SIZE, 70, 44, WHITE);
         // int measurement = MeasureText(title_text, 44);
         // printf("measurement: %d\n", measurement);
-        snprintf(artist_text, sizeof(artist_text), "%s", current_song.artist);
-        DrawText(artist_text, (2 * PADDING) + albumTexture.width, 70 + 22 + PADDING, 26, WHITE);
+        snprintf(artist_text, sizeof(artist_text), "%s", song->artist);
+        DrawText(artist_text, (2 * PADDING) + ART_SIZE, 70 + 22 + PADDING, 26, WHITE);
 
-        float progress_ratio = (current_song.duration > 0) ? (float)current_song.progress / current_song.duration : 0;
+        float progress_ratio = (song->duration > 0) ? (float)song->progress / song->duration : 0;
         GuiProgressBar((Rectangle){ 0, SCREEN_HEIGHT - 100, SCREEN_WIDTH, 2 }, "", "", &progress_ratio, 0, 1);
         
         DrawRectangle(0, SCREEN_HEIGHT - 98, SCREEN_WIDTH, 98, Fade(BLACK, 0.85f));
 
         // Draw control buttons
-        DrawTextureEx(cached_is_playing ? ui_textures.pause : ui_textures.play, 
-            (Vector2){controls.play_pause.x, controls.play_pause.y}, 0.0f, 
+        draw_icon(cached_is_playing ? ui_icons.pause : ui_icons.play, 
+            (Vector2){controls.play_pause.x, controls.play_pause.y}, 
             controls.play_pause_pressed ? 0.45f : 0.5f, 
             controls.play_pause_pressed ? GRAY : WHITE
         );
         
-        DrawTextureEx(ui_textures.shuffle, (Vector2){controls.shuffle.x, controls.shuffle.y}, 
-            0.0f, controls.shuffle_pressed ? 0.45f : 0.5f, 
+        draw_icon(ui_icons.shuffle, (Vector2){controls.shuffle.x, controls.shuffle.y}, 
+            controls.shuffle_pressed ? 0.45f : 0.5f, 
             (cached_is_shuffle ? Fade(GREEN, controls.shuffle_pressed ? 0.5f : 1.0f) :
             controls.shuffle_pressed ? GRAY : WHITE)
         );
         
-        DrawTextureEx(ui_textures.skip, (Vector2){controls.skip.x, controls.skip.y}, 0.0f, 
+        draw_icon(ui_icons.skip, (Vector2){controls.skip.x, controls.skip.y}, 
             controls.skip_pressed ? 0.45f : 0.5f, controls.skip_pressed ? GRAY : WHITE
         );
-        DrawTextureEx(ui_textures.prev, (Vector2){controls.prev.x, controls.prev.y}, 0.0f, 
+        draw_icon(ui_icons.prev, (Vector2){controls.prev.x, controls.prev.y}, 
             controls.prev_pressed ? 0.45f : 0.5f, controls.prev_pressed ? GRAY : WHITE
         );
 
-        DrawTextureEx(ui_textures.like, (Vector2){controls.like.x, controls.like.y}, 0.0f, 
+        draw_icon(ui_icons.like, (Vector2){controls.like.x, controls.like.y}, 
             controls.like_pressed ? 0.45f : 0.5f, 
             (cached_is_liked ? Fade(GREEN, controls.like_pressed ? 0.5f : 1.0f) : 
             controls.like_pressed ? GRAY : WHITE)
         );
 
-        DrawTextureEx(ui_textures.back, (Vector2){controls.back.x, controls.back.y}, 0.0f, 
+        draw_icon(ui_icons.back, (Vector2){controls.back.x, controls.back.y}, 
             controls.back_pressed ? 0.45f : 0.5f, controls.back_pressed ? GRAY : WHITE
         );
 
@@ -1528,63 +4120,36 @@ AppState display_app(AppState current_state) {
             controls.skip_pressed = false;
             controls.like_pressed = false;
 
-            char endpoint_url[512];
-            char access_token_copy[256];
-            strncpy(access_token_copy, spclient.access_token, sizeof(access_token_copy) - 1);
-            access_token_copy[sizeof(access_token_copy) - 1] = '\0';
-
+            // results come back through command_drain_results(), which also
+            // asks the poller for fresh state once spotify has the command
             if (CheckCollisionPointRec(input_pos, controls.play_pause)) {
                 controls.play_pause_pressed = true;
-                snprintf(endpoint_url, sizeof(endpoint_url), 
-                    cached_is_playing ? "https://api.spotify.com/v1/me/player/pause" : 
-                    "https://api.spotify.com/v1/me/player/play");
-                if (spotify_request(endpoint_url, access_token_copy, NULL)) {
+                if (command_enqueue(cached_is_playing ? CMD_PAUSE : CMD_PLAY, 0, NULL)) {
                     pthread_mutex_lock(&spclient_mutex);
-                    spclient.is_playing = !spclient.is_playing;
+                    spclient.is_playing = !cached_is_playing;
                     cached_is_playing = spclient.is_playing;
                     pthread_mutex_unlock(&spclient_mutex);
-                    should_refresh = true;
+                    playing_override_at = get_current_time();
                 }
             } else if (CheckCollisionPointRec(input_pos, controls.skip)) {
                 controls.skip_pressed = true;
-                snprintf(endpoint_url, sizeof(endpoint_url), 
-                    "https://api.spotify.com/v1/me/player/next");
-                if (spotify_post(endpoint_url, access_token_copy)) {
-                    should_refresh = true;
-                }
+                command_enqueue(CMD_NEXT, 0, NULL);
             } else if (CheckCollisionPointRec(input_pos, controls.prev)) {
                 controls.prev_pressed = true;
-                snprintf(endpoint_url, sizeof(endpoint_url), 
-                    "https://api.spotify.com/v1/me/player/previous");
-                if (spotify_post(endpoint_url, access_token_copy)) {
-                    should_refresh = true;
-                }
+                command_enqueue(CMD_PREVIOUS, 0, NULL);
             } else if (CheckCollisionPointRec(input_pos, controls.like)) {
                 controls.like_pressed = true;
-                char track_id[256];
-                pthread_mutex_lock(&spclient_mutex);
-                strncpy(track_id, spclient.current_track_id, sizeof(track_id) - 1);
-                track_id[sizeof(track_id) - 1] = '\0';
-                pthread_mutex_unlock(&spclient_mutex);
-                snprintf(endpoint_url, sizeof(endpoint_url), 
-                    "https://api.spotify.com/v1/me/tracks?ids=%s", track_id);
-                if (spotify_request(endpoint_url, access_token_copy, NULL)) {
-                    pthread_mutex_lock(&spclient_mutex);
+                if (command_enqueue(CMD_LIKE, 0, snap.track_id)) {
                     cached_is_liked = !cached_is_liked;
-                    pthread_mutex_unlock(&spclient_mutex);
-                    should_refresh = true;
                 }
             } else if (CheckCollisionPointRec(input_pos, controls.shuffle)) {
                 controls.shuffle_pressed = true;
-                snprintf(endpoint_url, sizeof(endpoint_url), 
-                    "https://api.spotify.com/v1/me/player/shuffle?state=%s",
-                    cached_is_shuffle ? "false" : "true");
-                if (spotify_request(endpoint_url, access_token_copy, NULL)) {
+                if (command_enqueue(CMD_SHUFFLE, !cached_is_shuffle, NULL)) {
                     pthread_mutex_lock(&spclient_mutex);
-                    spclient.shuffle = !spclient.shuffle;
+                    spclient.shuffle = !cached_is_shuffle;
                     cached_is_shuffle = spclient.shuffle;
                     pthread_mutex_unlock(&spclient_mutex);
-                    should_refresh = true;
+                    shuffle_override_at = get_current_time();
                 }
             } else if (CheckCollisionPointRec(input_pos, controls.back)) {
                 controls.back_pressed = true;
@@ -1592,24 +4157,15 @@ AppState display_app(AppState current_state) {
             }
         }
 
-        if (should_refresh) {
-            fetch_current_state(&current_song);
-            memcpy(&cached_song, &current_song, sizeof(SongInfo));
-            // do we need refresh album art here? or even:
-            // // Load new album art immediately
-            // if (strlen(current_song.url) > 0) {
-            //     albumTexture = load_album_art(current_song.url);
-            // }
-            // 
-            // seems like no but not 100% sure
+        if (command_error[0] && get_current_time() - command_error_time < COMMAND_ERROR_MS) {
+            DrawText(command_error, PADDING, SCREEN_HEIGHT - 100 - PADDING, 20, RED);
         }
     } else {
         // No active playback found, display a prompt and a refresh button.
         DrawText("No active Spotify device found.\nPlease open Spotify on a device.", 
                  SCREEN_WIDTH/2 - 150, SCREEN_HEIGHT/2 - PADDING, 20, WHITE);
         if (GuiButton((Rectangle){SCREEN_WIDTH/2 - 50, SCREEN_HEIGHT/2 + 20, 100, PADDING}, "Refresh")) {
-            fetch_current_state(&current_song);
-            memcpy(&cached_song, &current_song, sizeof(SongInfo));
+            request_state_refresh();
         }
     }
 
@@ -1619,13 +4175,51 @@ AppState display_app(AppState current_state) {
 int main() {
     signal(SIGINT, handle_sigint);
 
+    if (!http_init()) {
+        fprintf(stderr, "Failed to initialize libcurl\n");
+        return 1;
+    }
+
+    if (!http_engine_start()) {
+        fprintf(stderr, "Failed to start network engine\n");
+        return 1;
+    }
+
+    if (!command_lane_start()) {
+        fprintf(stderr, "Failed to start command worker\n");
+        return 1;
+    }
+
+    art_cache_open();
+    if (!art_pipeline_start()) {
+        fprintf(stderr, "Failed to start album art workers\n");
+        return 1;
+    }
+
     pthread_t gpio_t;
     if (pthread_create(&gpio_t, NULL, gpio_thread_func, NULL) != 0) {
         fprintf(stderr, "Failed to start GPIO Thread\n");
         return 1;
     }
 
+    pthread_t poller_t;
+    if (pthread_create(&poller_t, NULL, state_poller_thread, NULL) != 0) {
+        fprintf(stderr, "Failed to start state poller thread\n");
+        return 1;
+    }
+
+    pthread_t refresh_t;
+    if (pthread_create(&refresh_t, NULL, token_refresh_thread, NULL) != 0) {
+        fprintf(stderr, "Failed to start token refresh thread\n");
+        return 1;
+    }
+
     InitWindow(SCREEN_WIDTH, SCREEN_HEIGHT, "Spotify Pi Thing");
+    art_format_init();
+    if (!now_playing_art_init()) {
+        fprintf(stderr, "Failed to allocate album art textures\n");
+        return 1;
+    }
     GuiLoadStyleDark();
     SetTargetFPS(60);
 
@@ -1643,11 +4237,20 @@ int main() {
         return 1;
     }
 
+    if (!texture_cache_init()) {
+        fprintf(stderr, "Failed to allocate the thumbnail atlas\n");
+        return 1;
+    }
+
     while (!WindowShouldClose() && running) {
         if (IsKeyPressed(KEY_ESCAPE)) {
             running = 0;
         }
 
+        http_drain_completions();
+        command_drain_results();
+        art_upload_ready();
+
         BeginDrawing();
         ClearBackground(GetColor(GuiGetStyle(DEFAULT, BACKGROUND_COLOR)));
 
@@ -1790,31 +4393,29 @@ int main() {
 
     running = 0;
     pthread_join(gpio_t, NULL);
+    pthread_join(poller_t, NULL);
+    pthread_join(refresh_t, NULL);
+    command_lane_stop();
+    art_pipeline_stop();
+    http_engine_stop();
     if (qrtexture.id != 0) {
         UnloadTexture(qrtexture);
     }
 
-    if (ui_textures.play.id != 0) {
-        UnloadTexture(ui_textures.play);
-        UnloadTexture(ui_textures.pause);
-        UnloadTexture(ui_textures.skip);
-        UnloadTexture(ui_textures.prev);
-        UnloadTexture(ui_textures.shuffle);
-        UnloadTexture(ui_textures.like);
+    if (ui_icons.atlas.id != 0) {
+        UnloadTexture(ui_icons.atlas);
     }
 
-    for (int i = 0; i < texture_count; i++) {
-        if (playlist_textures[i].texture.id != 0) {
-            UnloadTexture(playlist_textures[i].texture);
-        }
-    }
+    texture_cache_clear();
+    now_playing_art_unload();
+    art_cache_close();
 
-    if (cached_playlists) {
-        cJSON_Delete(cached_playlists);
-        cached_playlists = NULL;
-    }
+    playlist_list_free(&home_playlists);
+    playlist_list_free(&spclient.playlists);
 
     CloseWindow();
+    http_print_stats();
+    http_cleanup();
 
     return 0;
 }
\ No newline at end of file
@@ -153,6 +153,26 @@ static int case_insensitive_strcmp(const unsigned char *string1, const unsigned
     return tolower(*string1) - tolower(*string2);
 }
 
+/* FNV-1a over the lowercased name, so the same hash serves case sensitive and insensitive lookups.
+ * Never returns 0, that marks a name whose hash isn't known. */
+static unsigned int key_hash(const unsigned char *string)
+{
+    unsigned int hash = 2166136261u;
+
+    if (string == NULL)
+    {
+        return 0;
+    }
+
+    for (; *string != '\0'; string++)
+    {
+        hash ^= (unsigned int)tolower(*string);
+        hash *= 16777619u;
+    }
+
+    return (hash == 0) ? 1 : hash;
+}
+
 typedef struct internal_hooks
 {
     void *(CJSON_CDECL *allocate)(size_t size);
@@ -237,6 +257,22 @@ CJSON_PUBLIC(void) cJSON_InitHooks(cJSON_Hooks* hooks)
     }
 }
 
+struct cJSON_ArrayIndex
+{
+    size_t count;
+    cJSON **items;
+};
+
+/* forget the index of an array whose children are about to change */
+static void drop_array_index(cJSON * const array)
+{
+    if ((array != NULL) && (array->index != NULL))
+    {
+        global_hooks.deallocate(array->index);
+        array->index = NULL;
+    }
+}
+
 /* Internal constructor. */
 static cJSON *cJSON_New_Item(const internal_hooks * const hooks)
 {
@@ -249,10 +285,117 @@ static cJSON *cJSON_New_Item(const internal_hooks * const hooks)
     return node;
 }
 
+/* Bump arena behind cJSON_ParseArena: every node and string of a document is
+ * carved out of a chain of large blocks, which are freed together with the root. */
+typedef struct arena_block
+{
+    struct arena_block *next;
+    size_t size;
+    size_t used;
+} arena_block;
+
+typedef struct
+{
+    arena_block *blocks;
+    cJSON root;
+} arena_document;
+
+/* Strictest alignment a node needs. cJSON holds a double, which wants 8 bytes even where pointers
+ * are 4 (32 bit ARM), and C89 has no _Alignof, so the padding in front of this union tells. */
+typedef union
+{
+    double number;
+    void *pointer;
+    size_t size;
+} arena_max_align;
+
+typedef struct
+{
+    char offset;
+    arena_max_align aligned;
+} arena_align_probe;
+
+#define arena_alignment offsetof(arena_align_probe, aligned)
+#define arena_align(size) (((size) + (arena_alignment - 1)) & ~(arena_alignment - 1))
+#define arena_block_header arena_align(sizeof(arena_block))
+#define arena_min_block 4096
+
+static arena_block *arena_new_block(size_t size)
+{
+    arena_block *block = (arena_block*)global_hooks.allocate(arena_block_header + size);
+    if (block != NULL)
+    {
+        block->next = NULL;
+        block->size = size;
+        block->used = 0;
+    }
+
+    return block;
+}
+
+static void *arena_allocate(arena_document * const document, size_t size)
+{
+    arena_block *block = document->blocks;
+    size = arena_align(size);
+    if ((block->size - block->used) < size)
+    {
+        /* new blocks go in front, each at least as big as the one before */
+        arena_block *grown = arena_new_block((size > block->size) ? size : block->size);
+        if (grown == NULL)
+        {
+            return NULL;
+        }
+        grown->next = block;
+        document->blocks = block = grown;
+    }
+
+    block->used += size;
+    return (unsigned char*)block + arena_block_header + block->used - size;
+}
+
+static void arena_free(arena_document * const document)
+{
+    arena_block *block = document->blocks;
+    while (block != NULL)
+    {
+        arena_block *next = block->next;
+        global_hooks.deallocate(block);
+        block = next;
+    }
+}
+
+static arena_document *arena_new_document(size_t input_length)
+{
+    /* about as many bytes of nodes as there is json text, plus the strings */
+    size_t first = arena_align(sizeof(arena_document)) + 2 * input_length;
+    arena_block *block = arena_new_block((first < arena_min_block) ? arena_min_block : first);
+    arena_document *document = NULL;
+    if (block == NULL)
+    {
+        return NULL;
+    }
+
+    document = (arena_document*)((unsigned char*)block + arena_block_header);
+    block->used = arena_align(sizeof(arena_document));
+    memset(document, '\0', sizeof(arena_document));
+    document->blocks = block;
+
+    return document;
+}
+
 /* Delete a cJSON structure. */
 CJSON_PUBLIC(void) cJSON_Delete(cJSON *item)
 {
     cJSON *next = NULL;
+    if ((item != NULL) && (item->type & cJSON_InArena))
+    {
+        /* arena nodes are only freed all at once, through their root */
+        if (item->type & cJSON_ArenaRoot)
+        {
+            arena_free((arena_document*)((unsigned char*)item - offsetof(arena_document, root)));
+        }
+        return;
+    }
     while (item != NULL)
     {
         next = item->next;
@@ -270,6 +413,10 @@ CJSON_PUBLIC(void) cJSON_Delete(cJSON *item)
             global_hooks.deallocate(item->string);
             item->string = NULL;
         }
+        if (!(item->type & cJSON_IsReference))
+        {
+            drop_array_index(item);
+        }
         global_hooks.deallocate(item);
         item = next;
     }
@@ -293,8 +440,46 @@ typedef struct
     size_t offset;
     size_t depth; /* How deeply nested (in arrays/objects) is the input at the current offset. */
     internal_hooks hooks;
+    arena_document *arena; /* nodes and strings come from here instead of hooks when set */
+    int node_flags; /* or'ed into the type of every parsed node */
+    const char * const *skip_keys; /* NULL terminated, members with these names are scanned over */
 } parse_buffer;
 
+static void *parse_allocate(parse_buffer * const input_buffer, size_t size)
+{
+    if (input_buffer->arena != NULL)
+    {
+        return arena_allocate(input_buffer->arena, size);
+    }
+    return input_buffer->hooks.allocate(size);
+}
+
+static cJSON *parse_new_item(parse_buffer * const input_buffer)
+{
+    cJSON *node = NULL;
+    if (input_buffer->arena == NULL)
+    {
+        return cJSON_New_Item(&(input_buffer->hooks));
+    }
+
+    node = (cJSON*)arena_allocate(input_buffer->arena, sizeof(cJSON));
+    if (node)
+    {
+        memset(node, '\0', sizeof(cJSON));
+    }
+
+    return node;
+}
+
+/* partially parsed arena nodes are left to the arena */
+static void parse_delete(parse_buffer * const input_buffer, cJSON *item)
+{
+    if (input_buffer->arena == NULL)
+    {
+        cJSON_Delete(item);
+    }
+}
+
 /* check if the given size is left to read in a given parse buffer (starting with 1) */
 #define can_read(buffer, size) ((buffer != NULL) && (((buffer)->offset + size) <= (buffer)->length))
 /* check if the buffer can be accessed at the given index (starting with 0) */
@@ -429,6 +614,11 @@ CJSON_PUBLIC(char*) cJSON_SetValuestring(cJSON *object, const char *valuestring)
         strcpy(object->valuestring, valuestring);
         return object->valuestring;
     }
+    /* arena strings can only be overwritten in place */
+    if (object->type & cJSON_InArena)
+    {
+        return NULL;
+    }
     copy = (char*) cJSON_strdup((const unsigned char*)valuestring, &global_hooks);
     if (copy == NULL)
     {
@@ -828,7 +1018,7 @@ static cJSON_bool parse_string(cJSON * const item, parse_buffer * const input_bu
 
         /* This is at most how much we need for the output */
         allocation_length = (size_t) (input_end - buffer_at_offset(input_buffer)) - skipped_bytes;
-        output = (unsigned char*)input_buffer->hooks.allocate(allocation_length + sizeof(""));
+        output = (unsigned char*)parse_allocate(input_buffer, allocation_length + sizeof(""));
         if (output == NULL)
         {
             goto fail; /* allocation failure */
@@ -904,7 +1094,7 @@ static cJSON_bool parse_string(cJSON * const item, parse_buffer * const input_bu
     return true;
 
 fail:
-    if (output != NULL)
+    if ((output != NULL) && (input_buffer->arena == NULL))
     {
         input_buffer->hooks.deallocate(output);
         output = NULL;
@@ -1112,9 +1302,9 @@ CJSON_PUBLIC(cJSON *) cJSON_ParseWithOpts(const char *value, const char **return
 }
 
 /* Parse an object - create a new root, and populate. */
-CJSON_PUBLIC(cJSON *) cJSON_ParseWithLengthOpts(const char *value, size_t buffer_length, const char **return_parse_end, cJSON_bool require_null_terminated)
+static cJSON *parse_document(const char *value, size_t buffer_length, const char **return_parse_end, cJSON_bool require_null_terminated, cJSON_bool use_arena, const char * const *skip_keys)
 {
-    parse_buffer buffer = { 0, 0, 0, 0, { 0, 0, 0 } };
+    parse_buffer buffer = { 0, 0, 0, 0, { 0, 0, 0 }, NULL, 0, NULL };
     cJSON *item = NULL;
 
     /* reset error position */
@@ -1130,8 +1320,22 @@ CJSON_PUBLIC(cJSON *) cJSON_ParseWithLengthOpts(const char *value, size_t buffer
     buffer.length = buffer_length;
     buffer.offset = 0;
     buffer.hooks = global_hooks;
+    buffer.skip_keys = skip_keys;
 
-    item = cJSON_New_Item(&global_hooks);
+    if (use_arena)
+    {
+        buffer.arena = arena_new_document(buffer_length);
+        if (buffer.arena == NULL) /* memory fail */
+        {
+            goto fail;
+        }
+        buffer.node_flags = cJSON_InArena;
+        item = &buffer.arena->root;
+    }
+    else
+    {
+        item = cJSON_New_Item(&global_hooks);
+    }
     if (item == NULL) /* memory fail */
     {
         goto fail;
@@ -1142,6 +1346,11 @@ CJSON_PUBLIC(cJSON *) cJSON_ParseWithLengthOpts(const char *value, size_t buffer
         /* parse failure. ep is set. */
         goto fail;
     }
+    item->type |= buffer.node_flags;
+    if (buffer.arena != NULL)
+    {
+        item->type |= cJSON_ArenaRoot;
+    }
 
     /* if we require null-terminated JSON without appended garbage, skip and then check for a null terminator */
     if (require_null_terminated)
@@ -1160,7 +1369,11 @@ CJSON_PUBLIC(cJSON *) cJSON_ParseWithLengthOpts(const char *value, size_t buffer
     return item;
 
 fail:
-    if (item != NULL)
+    if (buffer.arena != NULL)
+    {
+        arena_free(buffer.arena);
+    }
+    else if (item != NULL)
     {
         cJSON_Delete(item);
     }
@@ -1191,6 +1404,31 @@ fail:
     return NULL;
 }
 
+CJSON_PUBLIC(cJSON *) cJSON_ParseWithLengthOpts(const char *value, size_t buffer_length, const char **return_parse_end, cJSON_bool require_null_terminated)
+{
+    return parse_document(value, buffer_length, return_parse_end, require_null_terminated, false, NULL);
+}
+
+CJSON_PUBLIC(cJSON *) cJSON_ParseArena(const char *value)
+{
+    if (NULL == value)
+    {
+        return NULL;
+    }
+
+    return parse_document(value, strlen(value) + sizeof(""), 0, 0, true, NULL);
+}
+
+CJSON_PUBLIC(cJSON *) cJSON_ParseArenaWithLength(const char *value, size_t buffer_length)
+{
+    return parse_document(value, buffer_length, 0, 0, true, NULL);
+}
+
+CJSON_PUBLIC(cJSON *) cJSON_ParseWithSkipKeys(const char *value, size_t buffer_length, const char * const *skip_keys, cJSON_bool use_arena)
+{
+    return parse_document(value, buffer_length, 0, 0, use_arena, skip_keys);
+}
+
 /* Default options for cJSON_Parse */
 CJSON_PUBLIC(cJSON *) cJSON_Parse(const char *value)
 {
@@ -1500,7 +1738,7 @@ static cJSON_bool parse_array(cJSON * const item, parse_buffer * const input_buf
     do
     {
         /* allocate next item */
-        cJSON *new_item = cJSON_New_Item(&(input_buffer->hooks));
+        cJSON *new_item = parse_new_item(input_buffer);
         if (new_item == NULL)
         {
             goto fail; /* allocation failure */
@@ -1527,6 +1765,7 @@ static cJSON_bool parse_array(cJSON * const item, parse_buffer * const input_buf
         {
             goto fail; /* failed to parse value */
         }
+        current_item->type |= input_buffer->node_flags;
         buffer_skip_whitespace(input_buffer);
     }
     while (can_access_at_index(input_buffer, 0) && (buffer_at_offset(input_buffer)[0] == ','));
@@ -1553,7 +1792,7 @@ success:
 fail:
     if (head != NULL)
     {
-        cJSON_Delete(head);
+        parse_delete(input_buffer, head);
     }
 
     return false;
@@ -1621,6 +1860,205 @@ static cJSON_bool print_array(const cJSON * const item, printbuffer * const outp
     return true;
 }
 
+/* Skipping: scan past values the caller asked to leave out of the tree, see cJSON_ParseWithSkipKeys. */
+static cJSON_bool skip_member(parse_buffer * const input_buffer);
+
+/* Scan past a string without decoding it, input_buffer is left after the closing quote */
+static cJSON_bool skip_string(parse_buffer * const input_buffer)
+{
+    if (cannot_access_at_index(input_buffer, 0) || (buffer_at_offset(input_buffer)[0] != '\"'))
+    {
+        return false;
+    }
+
+    input_buffer->offset++;
+    while (can_access_at_index(input_buffer, 0))
+    {
+        switch (buffer_at_offset(input_buffer)[0])
+        {
+            case '\"':
+                input_buffer->offset++;
+                return true;
+
+            case '\\':
+                input_buffer->offset += 2; /* whatever is escaped can't end the string */
+                break;
+
+            default:
+                input_buffer->offset++;
+                break;
+        }
+    }
+
+    return false; /* string ended unexpectedly */
+}
+
+/* Scan past any value without building nodes. Only the structure is checked, escapes and
+ * number formats inside the skipped value are not validated the way parse_value does. */
+static cJSON_bool skip_value(parse_buffer * const input_buffer)
+{
+    unsigned char close = '\0';
+
+    if (cannot_access_at_index(input_buffer, 0))
+    {
+        return false;
+    }
+
+    switch (buffer_at_offset(input_buffer)[0])
+    {
+        case '\"':
+            return skip_string(input_buffer);
+
+        case '[':
+            close = ']';
+            break;
+
+        case '{':
+            close = '}';
+            break;
+
+        case 'n':
+            if (can_read(input_buffer, 4) && (strncmp((const char*)buffer_at_offset(input_buffer), "null", 4) == 0))
+            {
+                input_buffer->offset += 4;
+                return true;
+            }
+            return false;
+
+        case 'f':
+            if (can_read(input_buffer, 5) && (strncmp((const char*)buffer_at_offset(input_buffer), "false", 5) == 0))
+            {
+                input_buffer->offset += 5;
+                return true;
+            }
+            return false;
+
+        case 't':
+            if (can_read(input_buffer, 4) && (strncmp((const char*)buffer_at_offset(input_buffer), "true", 4) == 0))
+            {
+                input_buffer->offset += 4;
+                return true;
+            }
+            return false;
+
+        default:
+            if ((buffer_at_offset(input_buffer)[0] != '-') && ((buffer_at_offset(input_buffer)[0] < '0') || (buffer_at_offset(input_buffer)[0] > '9')))
+            {
+                return false;
+            }
+            while (can_access_at_index(input_buffer, 0) && (buffer_at_offset(input_buffer)[0] != '\0') && (strchr("0123456789+-eE.", buffer_at_offset(input_buffer)[0]) != NULL))
+            {
+                input_buffer->offset++;
+            }
+            return true;
+    }
+
+    /* array or object */
+    if (input_buffer->depth >= CJSON_NESTING_LIMIT)
+    {
+        return false; /* to deeply nested */
+    }
+    input_buffer->depth++;
+
+    input_buffer->offset++;
+    buffer_skip_whitespace(input_buffer);
+    if (can_access_at_index(input_buffer, 0) && (buffer_at_offset(input_buffer)[0] == close))
+    {
+        goto success; /* empty array or object */
+    }
+
+    for (;;)
+    {
+        buffer_skip_whitespace(input_buffer);
+        if (close == '}')
+        {
+            if (!skip_member(input_buffer))
+            {
+                return false;
+            }
+        }
+        else
+        {
+            if (!skip_value(input_buffer))
+            {
+                return false;
+            }
+            buffer_skip_whitespace(input_buffer);
+        }
+
+        if (cannot_access_at_index(input_buffer, 0))
+        {
+            return false;
+        }
+        if (buffer_at_offset(input_buffer)[0] == close)
+        {
+            break;
+        }
+        if (buffer_at_offset(input_buffer)[0] != ',')
+        {
+            return false; /* expected comma or end */
+        }
+        input_buffer->offset++;
+    }
+
+success:
+    input_buffer->depth--;
+    input_buffer->offset++;
+    return true;
+}
+
+/* Scan past a whole "name": value member, leaving the offset at whatever follows the value */
+static cJSON_bool skip_member(parse_buffer * const input_buffer)
+{
+    if (!skip_string(input_buffer))
+    {
+        return false; /* failed to skip name */
+    }
+    buffer_skip_whitespace(input_buffer);
+    if (cannot_access_at_index(input_buffer, 0) || (buffer_at_offset(input_buffer)[0] != ':'))
+    {
+        return false; /* invalid object */
+    }
+    input_buffer->offset++;
+    buffer_skip_whitespace(input_buffer);
+    if (!skip_value(input_buffer))
+    {
+        return false;
+    }
+    buffer_skip_whitespace(input_buffer);
+
+    return true;
+}
+
+/* true when the member name at the offset is on the skip list, compared raw so escaped names never match */
+static cJSON_bool member_is_skipped(const parse_buffer * const input_buffer)
+{
+    const char * const *key = NULL;
+
+    if ((input_buffer->skip_keys == NULL) || cannot_access_at_index(input_buffer, 0) || (buffer_at_offset(input_buffer)[0] != '\"'))
+    {
+        return false;
+    }
+
+    for (key = input_buffer->skip_keys; *key != NULL; key++)
+    {
+        size_t length = 0;
+        if (!can_access_at_index(input_buffer, 1) || (buffer_at_offset(input_buffer)[1] != (unsigned char)(*key)[0]))
+        {
+            continue; /* most names differ right away */
+        }
+        length = strlen(*key);
+        if (can_access_at_index(input_buffer, length + 1)
+            && (memcmp(buffer_at_offset(input_buffer) + 1, *key, length) == 0)
+            && (buffer_at_offset(input_buffer)[length + 1] == '\"'))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
 /* Build an object from the text. */
 static cJSON_bool parse_object(cJSON * const item, parse_buffer * const input_buffer)
 {
@@ -1657,8 +2095,27 @@ static cJSON_bool parse_object(cJSON * const item, parse_buffer * const input_bu
     /* loop through the comma separated array elements */
     do
     {
+        cJSON *new_item = NULL;
+
+        if (cannot_access_at_index(input_buffer, 1))
+        {
+            goto fail; /* nothing comes after the comma */
+        }
+
+        /* members on the skip list never get a node */
+        input_buffer->offset++;
+        buffer_skip_whitespace(input_buffer);
+        if (member_is_skipped(input_buffer))
+        {
+            if (!skip_member(input_buffer))
+            {
+                goto fail;
+            }
+            continue;
+        }
+
         /* allocate next item */
-        cJSON *new_item = cJSON_New_Item(&(input_buffer->hooks));
+        new_item = parse_new_item(input_buffer);
         if (new_item == NULL)
         {
             goto fail; /* allocation failure */
@@ -1678,14 +2135,7 @@ static cJSON_bool parse_object(cJSON * const item, parse_buffer * const input_bu
             current_item = new_item;
         }
 
-        if (cannot_access_at_index(input_buffer, 1))
-        {
-            goto fail; /* nothing comes after the comma */
-        }
-
         /* parse the name of the child */
-        input_buffer->offset++;
-        buffer_skip_whitespace(input_buffer);
         if (!parse_string(current_item, input_buffer))
         {
             goto fail; /* failed to parse name */
@@ -1695,6 +2145,7 @@ static cJSON_bool parse_object(cJSON * const item, parse_buffer * const input_bu
         /* swap valuestring and string, because we parsed the name */
         current_item->string = current_item->valuestring;
         current_item->valuestring = NULL;
+        current_item->string_hash = key_hash((const unsigned char*)current_item->string);
 
         if (cannot_access_at_index(input_buffer, 0) || (buffer_at_offset(input_buffer)[0] != ':'))
         {
@@ -1708,6 +2159,7 @@ static cJSON_bool parse_object(cJSON * const item, parse_buffer * const input_bu
         {
             goto fail; /* failed to parse value */
         }
+        current_item->type |= input_buffer->node_flags;
         buffer_skip_whitespace(input_buffer);
     }
     while (can_access_at_index(input_buffer, 0) && (buffer_at_offset(input_buffer)[0] == ','));
@@ -1733,7 +2185,7 @@ success:
 fail:
     if (head != NULL)
     {
-        cJSON_Delete(head);
+        parse_delete(input_buffer, head);
     }
 
     return false;
@@ -1864,6 +2316,11 @@ CJSON_PUBLIC(int) cJSON_GetArraySize(const cJSON *array)
         return 0;
     }
 
+    if (array->index != NULL)
+    {
+        return (int)array->index->count;
+    }
+
     child = array->child;
 
     while(child != NULL)
@@ -1877,6 +2334,47 @@ CJSON_PUBLIC(int) cJSON_GetArraySize(const cJSON *array)
     return (int)size;
 }
 
+static cJSON_bool build_array_index(cJSON * const array)
+{
+    struct cJSON_ArrayIndex *array_index = NULL;
+    cJSON *child = NULL;
+    size_t count = 0;
+
+    /* references share their children and arena nodes can't own heap memory */
+    if (array->type & (cJSON_IsReference | cJSON_InArena))
+    {
+        return false;
+    }
+
+    for (child = array->child; child != NULL; child = child->next)
+    {
+        count++;
+    }
+    if (count < CJSON_ARRAY_INDEX_MIN)
+    {
+        return false;
+    }
+
+    array_index = (struct cJSON_ArrayIndex*)global_hooks.allocate(sizeof(struct cJSON_ArrayIndex) + count * sizeof(cJSON*));
+    if (array_index == NULL)
+    {
+        return false;
+    }
+
+    array_index->count = count;
+    array_index->items = (cJSON**)(array_index + 1);
+    count = 0;
+    for (child = array->child; child != NULL; child = child->next)
+    {
+        array_index->items[count++] = child;
+    }
+    array->index = array_index;
+
+    return true;
+}
+
+static void* cast_away_const(const void* string);
+
 static cJSON* get_array_item(const cJSON *array, size_t index)
 {
     cJSON *current_child = NULL;
@@ -1886,6 +2384,11 @@ static cJSON* get_array_item(const cJSON *array, size_t index)
         return NULL;
     }
 
+    if ((array->index != NULL) || build_array_index((cJSON*)cast_away_const(array)))
+    {
+        return (index < array->index->count) ? array->index->items[index] : NULL;
+    }
+
     current_child = array->child;
     while ((current_child != NULL) && (index > 0))
     {
@@ -1906,26 +2409,36 @@ CJSON_PUBLIC(cJSON *) cJSON_GetArrayItem(const cJSON *array, int index)
     return get_array_item(array, (size_t)index);
 }
 
+/* A sibling with a known hash that differs from the name's can't match, only the rest get a string compare */
+static cJSON_bool object_key_may_match(const cJSON * const element, const unsigned int hash)
+{
+    return (element->string_hash == 0) || (element->string_hash == hash);
+}
+
 static cJSON *get_object_item(const cJSON * const object, const char * const name, const cJSON_bool case_sensitive)
 {
     cJSON *current_element = NULL;
+    unsigned int hash = 0;
 
     if ((object == NULL) || (name == NULL))
     {
         return NULL;
     }
 
+    hash = key_hash((const unsigned char*)name);
     current_element = object->child;
     if (case_sensitive)
     {
-        while ((current_element != NULL) && (current_element->string != NULL) && (strcmp(name, current_element->string) != 0))
+        while ((current_element != NULL) && (current_element->string != NULL)
+            && (!object_key_may_match(current_element, hash) || (strcmp(name, current_element->string) != 0)))
         {
             current_element = current_element->next;
         }
     }
     else
     {
-        while ((current_element != NULL) && (case_insensitive_strcmp((const unsigned char*)name, (const unsigned char*)(current_element->string)) != 0))
+        while ((current_element != NULL)
+            && (!object_key_may_match(current_element, hash) || (case_insensitive_strcmp((const unsigned char*)name, (const unsigned char*)(current_element->string)) != 0)))
         {
             current_element = current_element->next;
         }
@@ -1977,6 +2490,11 @@ static cJSON *create_reference(const cJSON *item, const internal_hooks * const h
 
     memcpy(reference, item, sizeof(cJSON));
     reference->string = NULL;
+    reference->string_hash = 0;
+    /* the index belongs to the referenced node, the reference never builds its own */
+    reference->index = NULL;
+    /* the reference itself is always on the heap, even when it points into an arena */
+    reference->type &= ~(cJSON_InArena | cJSON_ArenaRoot);
     reference->type |= cJSON_IsReference;
     reference->next = reference->prev = NULL;
     return reference;
@@ -1991,6 +2509,7 @@ static cJSON_bool add_item_to_array(cJSON *array, cJSON *item)
         return false;
     }
 
+    drop_array_index(array);
     child = array->child;
     /*
      * To find the last item in array quickly, we use prev in array
@@ -2069,6 +2588,7 @@ static cJSON_bool add_item_to_object(cJSON * const object, const char * const st
     }
 
     item->string = new_key;
+    item->string_hash = key_hash((const unsigned char*)new_key);
     item->type = new_type;
 
     return add_item_to_array(object, item);
@@ -2220,6 +2740,8 @@ CJSON_PUBLIC(cJSON *) cJSON_DetachItemViaPointer(cJSON *parent, cJSON * const it
         return NULL;
     }
 
+    drop_array_index(parent);
+
     if (item != parent->child)
     {
         /* not the first element */
@@ -2309,6 +2831,8 @@ CJSON_PUBLIC(cJSON_bool) cJSON_InsertItemInArray(cJSON *array, int which, cJSON
         return false;
     }
 
+    drop_array_index(array);
+
     newitem->next = after_inserted;
     newitem->prev = after_inserted->prev;
     after_inserted->prev = newitem;
@@ -2335,6 +2859,8 @@ CJSON_PUBLIC(cJSON_bool) cJSON_ReplaceItemViaPointer(cJSON * const parent, cJSON
         return true;
     }
 
+    drop_array_index(parent);
+
     replacement->next = item->next;
     replacement->prev = item->prev;
 
@@ -2400,6 +2926,7 @@ static cJSON_bool replace_item_in_object(cJSON *object, const char *string, cJSO
         return false;
     }
 
+    replacement->string_hash = key_hash((const unsigned char*)replacement->string);
     replacement->type &= ~cJSON_StringIsConst;
 
     return cJSON_ReplaceItemViaPointer(object, get_object_item(object, string, case_sensitive), replacement);
@@ -2763,7 +3290,7 @@ cJSON * cJSON_Duplicate_rec(const cJSON *item, size_t depth, cJSON_bool recurse)
         goto fail;
     }
     /* Copy over all vars */
-    newitem->type = item->type & (~cJSON_IsReference);
+    newitem->type = item->type & (~(cJSON_IsReference | cJSON_InArena | cJSON_ArenaRoot));
     newitem->valueint = item->valueint;
     newitem->valuedouble = item->valuedouble;
     if (item->valuestring)
@@ -2781,6 +3308,7 @@ cJSON * cJSON_Duplicate_rec(const cJSON *item, size_t depth, cJSON_bool recurse)
         {
             goto fail;
         }
+        newitem->string_hash = item->string_hash;
     }
     /* If non-recursive, then we're done! */
     if (!recurse)
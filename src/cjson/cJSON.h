@@ -98,6 +98,9 @@ then using the CJSON_API_VISIBILITY flag to "export" the same symbols the way CJ
 
 #define cJSON_IsReference 256
 #define cJSON_StringIsConst 512
+/* set on every node of a tree from cJSON_ParseArena, the root carries both */
+#define cJSON_InArena 1024
+#define cJSON_ArenaRoot 2048
 
 /* The cJSON structure: */
 typedef struct cJSON
@@ -120,6 +123,14 @@ typedef struct cJSON
 
     /* The item's name string, if this item is the child of, or is in the list of subitems of an object. */
     char *string;
+
+    /* Pointers to the children, built on the first indexed access of a big array or object and
+     * dropped when the children change through the cJSON API. Don't touch. */
+    struct cJSON_ArrayIndex *index;
+
+    /* Hash of the lowercased name, kept in step with string by the cJSON API so object lookups
+     * can skip most siblings without a string compare. 0 means not known. */
+    unsigned int string_hash;
 } cJSON;
 
 typedef struct cJSON_Hooks
@@ -137,6 +148,14 @@ typedef int cJSON_bool;
 #define CJSON_NESTING_LIMIT 1000
 #endif
 
+/* Arrays and objects with at least this many children get an index on the first
+ * cJSON_GetArrayItem, so indexed loops over them are linear instead of quadratic.
+ * The index is built on read, so a tree shared between threads needs to be indexed
+ * (or only walked with cJSON_ArrayForEach) before it is shared. Arena trees are never indexed. */
+#ifndef CJSON_ARRAY_INDEX_MIN
+#define CJSON_ARRAY_INDEX_MIN 16
+#endif
+
 /* Limits the length of circular references can be before cJSON rejects to parse them.
  * This is to prevent stack overflows. */
 #ifndef CJSON_CIRCULAR_LIMIT
@@ -157,6 +176,17 @@ CJSON_PUBLIC(cJSON *) cJSON_ParseWithLength(const char *value, size_t buffer_len
 /* If you supply a ptr in return_parse_end and parsing fails, then return_parse_end will contain a pointer to the error so will match cJSON_GetErrorPtr(). */
 CJSON_PUBLIC(cJSON *) cJSON_ParseWithOpts(const char *value, const char **return_parse_end, cJSON_bool require_null_terminated);
 CJSON_PUBLIC(cJSON *) cJSON_ParseWithLengthOpts(const char *value, size_t buffer_length, const char **return_parse_end, cJSON_bool require_null_terminated);
+/* Parse into a bump arena: every node and string of the document is allocated linearly from a few
+ * big blocks and cJSON_Delete() on the root frees them all at once. The tree is meant to be read:
+ * cJSON_Delete() on a node inside it does nothing. Detaching one does unlink it, but its memory
+ * still belongs to the arena, so it stays valid only until the root is deleted and must never be
+ * added to another tree. References (cJSON_AddItemReferenceTo*) are the way to share arena nodes. */
+CJSON_PUBLIC(cJSON *) cJSON_ParseArena(const char *value);
+CJSON_PUBLIC(cJSON *) cJSON_ParseArenaWithLength(const char *value, size_t buffer_length);
+/* Parse leaving out every object member, at any depth, whose name is in skip_keys (NULL terminated,
+ * compared case sensitively with the raw name in the input). Their values are scanned over without
+ * allocating anything, so they are simply missing from the tree. use_arena parses like cJSON_ParseArena. */
+CJSON_PUBLIC(cJSON *) cJSON_ParseWithSkipKeys(const char *value, size_t buffer_length, const char * const *skip_keys, cJSON_bool use_arena);
 
 /* Render a cJSON entity to text for transfer/storage. */
 CJSON_PUBLIC(char *) cJSON_Print(const cJSON *item);
@@ -0,0 +1,194 @@
+#include <stdint.h>
+#include <string.h>
+#include "art_image.h"
+
+/*
+    small ETC1 block encoder. every block tries both subblock orientations,
+    takes the subblock averages as base colours (differential 555 + 333 when
+    the two are close enough, individual 444 otherwise) and then picks the
+    modifier table and per pixel modifier with the lowest squared error.
+    not the best quality an offline tool would get, but album art survives
+    it fine and a 256x256 image takes a few milliseconds
+*/
+
+static const int etc_tables[8][2] = {
+    { 2, 8 }, { 5, 17 }, { 9, 29 }, { 13, 42 }, { 18, 60 }, { 24, 80 }, { 33, 106 }, { 47, 183 }
+};
+
+// pixel index bits (msb lsb): 00 +a, 01 +b, 10 -a, 11 -b
+static const int etc_index_sign[4] = { 1, 1, -1, -1 };
+static const int etc_index_col[4] = { 0, 1, 0, 1 };
+
+static int clamp255(int v) {
+    return v < 0 ? 0 : v > 255 ? 255 : v;
+}
+
+typedef struct {
+    int base[3];
+    int table;
+    int indices[8];
+    int error;
+} EtcSub;
+
+// pixels of one subblock as (x, y) pairs inside the 4x4 block
+static void sub_coords(int flip, int half, int coords[8][2]) {
+    int n = 0;
+    for (int y = 0; y < 4; y++) {
+        for (int x = 0; x < 4; x++) {
+            bool in = flip ? (y / 2 == half) : (x / 2 == half);
+            if (in) {
+                coords[n][0] = x;
+                coords[n][1] = y;
+                n++;
+            }
+        }
+    }
+}
+
+static void fit_sub(const uint8_t block[4][4][4], int coords[8][2], EtcSub *sub) {
+    sub->error = -1;
+    for (int t = 0; t < 8; t++) {
+        int error = 0;
+        int indices[8];
+        for (int p = 0; p < 8; p++) {
+            const uint8_t *px = block[coords[p][1]][coords[p][0]];
+            int best = 0;
+            int best_error = -1;
+            for (int i = 0; i < 4; i++) {
+                int mod = etc_index_sign[i] * etc_tables[t][etc_index_col[i]];
+                int e = 0;
+                for (int c = 0; c < 3; c++) {
+                    int d = clamp255(sub->base[c] + mod) - px[c];
+                    e += d * d;
+                }
+                if (best_error < 0 || e < best_error) {
+                    best_error = e;
+                    best = i;
+                }
+            }
+            indices[p] = best;
+            error += best_error;
+        }
+        if (sub->error < 0 || error < sub->error) {
+            sub->error = error;
+            sub->table = t;
+            memcpy(sub->indices, indices, sizeof(indices));
+        }
+    }
+}
+
+static uint64_t encode_block(const uint8_t block[4][4][4]) {
+    uint64_t best_bits = 0;
+    int best_error = -1;
+
+    for (int flip = 0; flip < 2; flip++) {
+        int coords[2][8][2];
+        int avg[2][3];
+        for (int half = 0; half < 2; half++) {
+            sub_coords(flip, half, coords[half]);
+            for (int c = 0; c < 3; c++) {
+                int sum = 0;
+                for (int p = 0; p < 8; p++) {
+                    sum += block[coords[half][p][1]][coords[half][p][0]][c];
+                }
+                avg[half][c] = (sum + 4) / 8;
+            }
+        }
+
+        // differential mode keeps 5 bits per channel if the second colour is within -4..3 steps
+        int q5[2][3];
+        bool differential = true;
+        for (int c = 0; c < 3; c++) {
+            q5[0][c] = (avg[0][c] * 31 + 127) / 255;
+            q5[1][c] = (avg[1][c] * 31 + 127) / 255;
+            int d = q5[1][c] - q5[0][c];
+            if (d < -4 || d > 3) {
+                differential = false;
+            }
+        }
+
+        EtcSub subs[2];
+        int q4[2][3];
+        for (int half = 0; half < 2; half++) {
+            for (int c = 0; c < 3; c++) {
+                if (differential) {
+                    subs[half].base[c] = (q5[half][c] << 3) | (q5[half][c] >> 2);
+                } else {
+                    q4[half][c] = (avg[half][c] * 15 + 127) / 255;
+                    subs[half].base[c] = (q4[half][c] << 4) | q4[half][c];
+                }
+            }
+            fit_sub(block, coords[half], &subs[half]);
+        }
+
+        int error = subs[0].error + subs[1].error;
+        if (best_error >= 0 && error >= best_error) {
+            continue;
+        }
+        best_error = error;
+
+        uint64_t bits = 0;
+        for (int c = 0; c < 3; c++) {
+            int shift = 59 - c * 8;
+            if (differential) {
+                bits |= (uint64_t)q5[0][c] << shift;
+                bits |= (uint64_t)((q5[1][c] - q5[0][c]) & 7) << (shift - 3);
+            } else {
+                bits |= (uint64_t)q4[0][c] << (shift + 1);
+                bits |= (uint64_t)q4[1][c] << (shift - 3);
+            }
+        }
+        bits |= (uint64_t)subs[0].table << 37;
+        bits |= (uint64_t)subs[1].table << 34;
+        bits |= (uint64_t)(differential ? 1 : 0) << 33;
+        bits |= (uint64_t)flip << 32;
+
+        // index bits are column major, msbs in the upper half
+        for (int half = 0; half < 2; half++) {
+            for (int p = 0; p < 8; p++) {
+                int bit = coords[half][p][0] * 4 + coords[half][p][1];
+                int index = subs[half].indices[p];
+                bits |= (uint64_t)(index >> 1) << (16 + bit);
+                bits |= (uint64_t)(index & 1) << bit;
+            }
+        }
+        best_bits = bits;
+    }
+
+    return best_bits;
+}
+
+void art_etc1_encode(const unsigned char *rgba, int width, int height, unsigned char *out) {
+    for (int by = 0; by < height; by += 4) {
+        for (int bx = 0; bx < width; bx += 4) {
+            uint8_t block[4][4][4];
+            for (int y = 0; y < 4; y++) {
+                memcpy(block[y], rgba + ((size_t)(by + y) * width + bx) * 4, 16);
+            }
+
+            uint64_t bits = encode_block(block);
+            for (int i = 0; i < 8; i++) {
+                out[i] = bits >> (56 - i * 8);
+            }
+            out += 8;
+        }
+    }
+}
+
+bool art_encode_etc(Image *image) {
+    if (image->format != PIXELFORMAT_UNCOMPRESSED_R8G8B8A8 || image->width % 4 || image->height % 4) {
+        return false;
+    }
+
+    unsigned char *blocks = art_pixels_alloc(image->width, image->height, PIXELFORMAT_COMPRESSED_ETC2_RGB);
+    if (!blocks) {
+        return false;
+    }
+    art_etc1_encode(image->data, image->width, image->height, blocks);
+
+    art_pixels_free(image->data);
+    image->data = blocks;
+    image->format = PIXELFORMAT_COMPRESSED_ETC2_RGB;
+    image->mipmaps = 1;
+    return true;
+}
@@ -0,0 +1,92 @@
+#include <stdio.h>
+#include <setjmp.h>
+#include <jpeglib.h>
+#include "art_image.h"
+
+typedef struct {
+    struct jpeg_error_mgr base;
+    jmp_buf escape;
+} ArtJpegError;
+
+static void art_jpeg_error_exit(j_common_ptr cinfo) {
+    ArtJpegError *err = (ArtJpegError *)cinfo->err;
+    char message[JMSG_LENGTH_MAX];
+    (*cinfo->err->format_message)(cinfo, message);
+    fprintf(stderr, "JPEG decode failed: %s\n", message);
+    longjmp(err->escape, 1);
+}
+
+// spotify serves progressive jpegs now and then, those warn a lot and still decode
+static void art_jpeg_output_message(j_common_ptr cinfo) {
+}
+
+bool art_is_jpeg(const unsigned char *data, size_t size) {
+    return size >= 3 && data[0] == 0xFF && data[1] == 0xD8 && data[2] == 0xFF;
+}
+
+bool art_decode_jpeg(const unsigned char *data, size_t size, int target, Image *out) {
+    struct jpeg_decompress_struct cinfo;
+    ArtJpegError err;
+    // volatile so it survives the longjmp back out of libjpeg
+    unsigned char *volatile pixels = NULL;
+
+    cinfo.err = jpeg_std_error(&err.base);
+    err.base.error_exit = art_jpeg_error_exit;
+    err.base.output_message = art_jpeg_output_message;
+    if (setjmp(err.escape)) {
+        jpeg_destroy_decompress(&cinfo);
+        if (pixels) {
+            MemFree(pixels);
+        }
+        return false;
+    }
+
+    jpeg_create_decompress(&cinfo);
+    jpeg_mem_src(&cinfo, (unsigned char *)data, size);
+    if (jpeg_read_header(&cinfo, TRUE) != JPEG_HEADER_OK) {
+        jpeg_destroy_decompress(&cinfo);
+        return false;
+    }
+
+    // largest denominator that still leaves both sides at least target wide
+    unsigned int denom = 1;
+    while (denom < 8 && cinfo.image_width / (denom * 2) >= (unsigned int)target &&
+        cinfo.image_height / (denom * 2) >= (unsigned int)target) {
+        denom *= 2;
+    }
+    cinfo.scale_num = 1;
+    cinfo.scale_denom = denom;
+#ifdef JCS_EXTENSIONS
+    // straight to the layout the resizer and the gpu want
+    cinfo.out_color_space = JCS_EXT_RGBA;
+#else
+    cinfo.out_color_space = JCS_RGB;
+#endif
+    // the result gets resized again anyway, trade a little quality for speed
+    cinfo.dct_method = JDCT_IFAST;
+    cinfo.do_fancy_upsampling = FALSE;
+
+    jpeg_start_decompress(&cinfo);
+    size_t stride = (size_t)cinfo.output_width * cinfo.output_components;
+    pixels = MemAlloc(stride * cinfo.output_height);
+    if (!pixels) {
+        jpeg_destroy_decompress(&cinfo);
+        return false;
+    }
+
+    while (cinfo.output_scanline < cinfo.output_height) {
+        JSAMPROW row = pixels + stride * cinfo.output_scanline;
+        jpeg_read_scanlines(&cinfo, &row, 1);
+    }
+
+    jpeg_finish_decompress(&cinfo);
+    *out = (Image){
+        .data = pixels,
+        .width = cinfo.output_width,
+        .height = cinfo.output_height,
+        .mipmaps = 1,
+        .format = cinfo.output_components == 4 ? PIXELFORMAT_UNCOMPRESSED_R8G8B8A8 : PIXELFORMAT_UNCOMPRESSED_R8G8B8
+    };
+    jpeg_destroy_decompress(&cinfo);
+    return true;
+}
@@ -0,0 +1,60 @@
+#ifndef ART_IMAGE_H
+#define ART_IMAGE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "raylib.h"
+
+// decodes a jpeg with libjpeg, letting the idct scale it down by 1/2, 1/4 or
+// 1/8 as long as the result still covers target x target. the image comes
+// back as R8G8B8A8 (R8G8B8 on a libjpeg without the turbo extensions) owned
+// by raylib (UnloadImage) and is usually still a bit bigger than target,
+// the caller does the final resize
+bool art_decode_jpeg(const unsigned char *data, size_t size, int target, Image *out);
+
+// true for data starting with a jpeg SOI marker
+bool art_is_jpeg(const unsigned char *data, size_t size);
+
+typedef enum {
+    ART_RESIZE_SCALAR,
+    ART_RESIZE_SSE2,
+    ART_RESIZE_NEON
+} ArtResizeKernel;
+
+// area average RGBA8 resize, every kernel gives bit identical output. the
+// fastest kernel the cpu supports is picked on first use after checking it
+// against scalar, PITHING_RESIZE=scalar in the environment forces scalar.
+// each calling thread keeps its weight tables and tmp rows between calls
+bool art_resize_rgba(const unsigned char *src, int sw, int sh, unsigned char *dst, int dw, int dh);
+bool art_resize_rgba_with(ArtResizeKernel kernel, const unsigned char *src, int sw, int sh,
+    unsigned char *dst, int dw, int dh);
+
+// converts to R8G8B8A8 if needed and resizes in place, the new pixels come
+// from art_pixels_alloc() so free the image with art_image_unload()
+bool art_resize_image(Image *image, int width, int height);
+
+ArtResizeKernel art_resize_active();
+bool art_resize_supported(ArtResizeKernel kernel);
+bool art_resize_matches_scalar(ArtResizeKernel kernel);
+const char *art_resize_kernel_name(ArtResizeKernel kernel);
+
+// encodes RGBA8 into ETC1 blocks, which every ETC2 decoder reads as well.
+// width and height must be multiples of 4, out needs width * height / 2 bytes
+void art_etc1_encode(const unsigned char *rgba, int width, int height, unsigned char *out);
+
+// replaces an RGBA8 image with its ETC1 encoding, tagged ETC2_RGB so raylib
+// uploads it as GL_COMPRESSED_RGB8_ETC2. alpha is dropped, free the image
+// with art_image_unload()
+bool art_encode_etc(Image *image);
+
+// pixels for a width x height image, 64, 100 and 256 px RGBA8 or ETC2_RGB
+// images come from a reusable slab and everything else from MemAlloc
+void *art_pixels_alloc(int width, int height, int format);
+// frees pixels from art_pixels_alloc() or from raylib
+void art_pixels_free(void *pixels);
+// UnloadImage() for images that went through the resizer or the encoder
+void art_image_unload(Image image);
+// slab hits, misses because every buffer of the size was out, and other sizes
+void art_slab_stats(unsigned *hits, unsigned *misses, unsigned *other);
+
+#endif
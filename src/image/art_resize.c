@@ -0,0 +1,450 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include "art_image.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define ART_HAVE_SSE2 1
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define ART_HAVE_NEON 1
+#if !defined(__aarch64__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+#endif
+
+/*
+    area average downscaler for RGBA8, done as two separable passes in fixed point
+    so every kernel produces the exact same bytes:
+
+    horizontal: tmp = (sum(w * src) + 32) >> 6        weights sum to 1 << 14, tmp is value * 256
+    vertical:   dst = (sum(w * tmp) + (1 << 21)) >> 22
+*/
+
+#define WEIGHT_BITS 14
+#define WEIGHT_ONE (1 << WEIGHT_BITS)
+
+typedef struct {
+    // the src -> dst length this was built for, 0 when empty
+    int src;
+    int dst;
+    int *start;
+    int *count;
+    // count[i] weights per output, padded out to taps
+    uint16_t *weights;
+    int taps;
+} ResizeAxis;
+
+// art goes through the same few src -> dst lengths over and over, so each
+// thread keeps the axes it built and one tmp buffer that only ever grows
+// instead of allocating them per resize. freed when the thread exits
+#define AXIS_CACHE_SIZE 6
+
+typedef struct {
+    ResizeAxis axes[AXIS_CACHE_SIZE];
+    int next;
+    uint16_t *tmp;
+    size_t tmp_count;
+} ResizeScratch;
+
+typedef void (*ResizeRowFn)(const uint8_t *src, uint16_t *tmp, int dw, const ResizeAxis *ax);
+typedef void (*ResizeColFn)(const uint16_t *tmp, int n, const uint16_t *weights, int count, uint8_t *dst);
+
+static bool axis_init(ResizeAxis *ax, int src, int dst) {
+    // output i covers [i * src, (i + 1) * src) and input j covers [j * dst, (j + 1) * dst)
+    ax->src = src;
+    ax->dst = dst;
+    ax->taps = (src + dst - 1) / dst + 1;
+    ax->start = malloc(sizeof(int) * dst);
+    ax->count = malloc(sizeof(int) * dst);
+    ax->weights = calloc((size_t)dst * ax->taps, sizeof(uint16_t));
+    if (!ax->start || !ax->count || !ax->weights) {
+        return false;
+    }
+
+    for (int i = 0; i < dst; i++) {
+        long lo = (long)i * src;
+        long hi = lo + src;
+        int first = lo / dst;
+        int last = (hi - 1) / dst;
+        uint16_t *w = &ax->weights[(size_t)i * ax->taps];
+        int total = 0;
+
+        ax->start[i] = first;
+        ax->count[i] = last - first + 1;
+        for (int j = first; j <= last; j++) {
+            long in_lo = (long)j * dst;
+            long in_hi = in_lo + dst;
+            long overlap = (hi < in_hi ? hi : in_hi) - (lo > in_lo ? lo : in_lo);
+            w[j - first] = (overlap * WEIGHT_ONE + src / 2) / src;
+            total += w[j - first];
+        }
+        // rounding leftovers go to the biggest tap so every row sums to exactly one
+        int biggest = 0;
+        for (int k = 1; k < ax->count[i]; k++) {
+            if (w[k] > w[biggest]) {
+                biggest = k;
+            }
+        }
+        w[biggest] += WEIGHT_ONE - total;
+    }
+
+    return true;
+}
+
+static void axis_free(ResizeAxis *ax) {
+    free(ax->start);
+    free(ax->count);
+    free(ax->weights);
+    *ax = (ResizeAxis){0};
+}
+
+static pthread_key_t scratch_key;
+static pthread_once_t scratch_once = PTHREAD_ONCE_INIT;
+
+static void scratch_free(void *data) {
+    ResizeScratch *scratch = data;
+    for (int i = 0; i < AXIS_CACHE_SIZE; i++) {
+        axis_free(&scratch->axes[i]);
+    }
+    free(scratch->tmp);
+    free(scratch);
+}
+
+static void scratch_key_init() {
+    pthread_key_create(&scratch_key, scratch_free);
+}
+
+static ResizeScratch *scratch_get() {
+    pthread_once(&scratch_once, scratch_key_init);
+    ResizeScratch *scratch = pthread_getspecific(scratch_key);
+    if (!scratch) {
+        scratch = calloc(1, sizeof(ResizeScratch));
+        if (scratch && pthread_setspecific(scratch_key, scratch) != 0) {
+            free(scratch);
+            scratch = NULL;
+        }
+    }
+    return scratch;
+}
+
+// cached axis for src -> dst, building it over the oldest entry that isn't keep
+static const ResizeAxis *axis_get(ResizeScratch *scratch, int src, int dst, const ResizeAxis *keep) {
+    for (int i = 0; i < AXIS_CACHE_SIZE; i++) {
+        if (scratch->axes[i].src == src && scratch->axes[i].dst == dst) {
+            return &scratch->axes[i];
+        }
+    }
+
+    if (&scratch->axes[scratch->next] == keep) {
+        scratch->next = (scratch->next + 1) % AXIS_CACHE_SIZE;
+    }
+    ResizeAxis *ax = &scratch->axes[scratch->next];
+    scratch->next = (scratch->next + 1) % AXIS_CACHE_SIZE;
+
+    axis_free(ax);
+    if (!axis_init(ax, src, dst)) {
+        axis_free(ax);
+        return NULL;
+    }
+    return ax;
+}
+
+static uint16_t *scratch_tmp(ResizeScratch *scratch, size_t count) {
+    if (count > scratch->tmp_count) {
+        free(scratch->tmp);
+        scratch->tmp = malloc(sizeof(uint16_t) * count);
+        scratch->tmp_count = scratch->tmp ? count : 0;
+    }
+    return scratch->tmp;
+}
+
+static void row_scalar(const uint8_t *src, uint16_t *tmp, int dw, const ResizeAxis *ax) {
+    for (int x = 0; x < dw; x++) {
+        const uint8_t *p = src + ax->start[x] * 4;
+        const uint16_t *w = &ax->weights[(size_t)x * ax->taps];
+        uint32_t acc[4] = {0};
+        for (int k = 0; k < ax->count[x]; k++, p += 4) {
+            acc[0] += w[k] * p[0];
+            acc[1] += w[k] * p[1];
+            acc[2] += w[k] * p[2];
+            acc[3] += w[k] * p[3];
+        }
+        for (int c = 0; c < 4; c++) {
+            tmp[x * 4 + c] = (acc[c] + 32) >> 6;
+        }
+    }
+}
+
+// outputs first..n-1 of one row, the simd kernels use it for their tail
+static void col_scalar_from(const uint16_t *tmp, int n, const uint16_t *weights, int count, uint8_t *dst, int first) {
+    for (int i = first; i < n; i++) {
+        uint32_t acc = 0;
+        for (int k = 0; k < count; k++) {
+            acc += (uint32_t)weights[k] * tmp[(size_t)k * n + i];
+        }
+        dst[i] = (acc + (1 << 21)) >> 22;
+    }
+}
+
+static void col_scalar(const uint16_t *tmp, int n, const uint16_t *weights, int count, uint8_t *dst) {
+    col_scalar_from(tmp, n, weights, count, dst, 0);
+}
+
+#ifdef ART_HAVE_SSE2
+static void row_sse2(const uint8_t *src, uint16_t *tmp, int dw, const ResizeAxis *ax) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i round = _mm_set1_epi32(32);
+    const __m128i bias32 = _mm_set1_epi32(32768);
+    const __m128i bias16 = _mm_set1_epi16((short)0x8000);
+
+    for (int x = 0; x < dw; x++) {
+        const uint8_t *p = src + ax->start[x] * 4;
+        const uint16_t *w = &ax->weights[(size_t)x * ax->taps];
+        __m128i acc = zero;
+        for (int k = 0; k < ax->count[x]; k++, p += 4) {
+            uint32_t word;
+            memcpy(&word, p, 4);
+            // [r 0 g 0 b 0 a 0] as 16 bit lanes, madd against [w 0 ...] is r * w per 32 bit lane
+            __m128i px = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(word), zero), zero);
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(px, _mm_set1_epi32(w[k])));
+        }
+        acc = _mm_srli_epi32(_mm_add_epi32(acc, round), 6);
+        // packs is signed, shift into range and back to keep 0..65280 intact
+        __m128i packed = _mm_add_epi16(_mm_packs_epi32(_mm_sub_epi32(acc, bias32), zero), bias16);
+        _mm_storel_epi64((__m128i *)&tmp[x * 4], packed);
+    }
+}
+
+static void col_sse2(const uint16_t *tmp, int n, const uint16_t *weights, int count, uint8_t *dst) {
+    const __m128i round = _mm_set1_epi32(1 << 21);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i acc0 = _mm_setzero_si128();
+        __m128i acc1 = _mm_setzero_si128();
+        for (int k = 0; k < count; k++) {
+            __m128i v = _mm_loadu_si128((const __m128i *)&tmp[(size_t)k * n + i]);
+            __m128i w = _mm_set1_epi16((short)weights[k]);
+            __m128i lo = _mm_mullo_epi16(v, w);
+            __m128i hi = _mm_mulhi_epu16(v, w);
+            acc0 = _mm_add_epi32(acc0, _mm_unpacklo_epi16(lo, hi));
+            acc1 = _mm_add_epi32(acc1, _mm_unpackhi_epi16(lo, hi));
+        }
+        acc0 = _mm_srli_epi32(_mm_add_epi32(acc0, round), 22);
+        acc1 = _mm_srli_epi32(_mm_add_epi32(acc1, round), 22);
+        __m128i bytes = _mm_packus_epi16(_mm_packs_epi32(acc0, acc1), _mm_setzero_si128());
+        _mm_storel_epi64((__m128i *)&dst[i], bytes);
+    }
+    col_scalar_from(tmp, n, weights, count, dst, i);
+}
+#endif
+
+#ifdef ART_HAVE_NEON
+static void row_neon(const uint8_t *src, uint16_t *tmp, int dw, const ResizeAxis *ax) {
+    for (int x = 0; x < dw; x++) {
+        const uint8_t *p = src + ax->start[x] * 4;
+        const uint16_t *w = &ax->weights[(size_t)x * ax->taps];
+        uint32x4_t acc = vdupq_n_u32(0);
+        for (int k = 0; k < ax->count[x]; k++, p += 4) {
+            uint32_t word;
+            memcpy(&word, p, 4);
+            uint16x8_t px = vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(word)));
+            acc = vmlal_n_u16(acc, vget_low_u16(px), w[k]);
+        }
+        acc = vshrq_n_u32(vaddq_u32(acc, vdupq_n_u32(32)), 6);
+        vst1_u16(&tmp[x * 4], vmovn_u32(acc));
+    }
+}
+
+static void col_neon(const uint16_t *tmp, int n, const uint16_t *weights, int count, uint8_t *dst) {
+    const uint32x4_t round = vdupq_n_u32(1 << 21);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint32x4_t acc0 = vdupq_n_u32(0);
+        uint32x4_t acc1 = vdupq_n_u32(0);
+        for (int k = 0; k < count; k++) {
+            uint16x8_t v = vld1q_u16(&tmp[(size_t)k * n + i]);
+            acc0 = vmlal_n_u16(acc0, vget_low_u16(v), weights[k]);
+            acc1 = vmlal_n_u16(acc1, vget_high_u16(v), weights[k]);
+        }
+        acc0 = vshrq_n_u32(vaddq_u32(acc0, round), 22);
+        acc1 = vshrq_n_u32(vaddq_u32(acc1, round), 22);
+        uint16x8_t narrow = vcombine_u16(vmovn_u32(acc0), vmovn_u32(acc1));
+        vst1_u8(&dst[i], vmovn_u16(narrow));
+    }
+    col_scalar_from(tmp, n, weights, count, dst, i);
+}
+#endif
+
+static bool resize_with(ResizeRowFn row, ResizeColFn col, const uint8_t *src, int sw, int sh,
+    uint8_t *dst, int dw, int dh) {
+    ResizeScratch *scratch = scratch_get();
+    if (!scratch) {
+        return false;
+    }
+
+    int n = dw * 4;
+    const ResizeAxis *ax = axis_get(scratch, sw, dw, NULL);
+    const ResizeAxis *ay = ax ? axis_get(scratch, sh, dh, ax) : NULL;
+    uint16_t *tmp = ay ? scratch_tmp(scratch, (size_t)n * sh) : NULL;
+    if (!tmp) {
+        return false;
+    }
+
+    for (int y = 0; y < sh; y++) {
+        row(src + (size_t)y * sw * 4, tmp + (size_t)y * n, dw, ax);
+    }
+    for (int y = 0; y < dh; y++) {
+        col(tmp + (size_t)ay->start[y] * n, n, &ay->weights[(size_t)y * ay->taps], ay->count[y], dst + (size_t)y * n);
+    }
+    return true;
+}
+
+static bool resize_kernel(ArtResizeKernel kernel, const uint8_t *src, int sw, int sh, uint8_t *dst, int dw, int dh) {
+    switch (kernel) {
+#ifdef ART_HAVE_SSE2
+        case ART_RESIZE_SSE2:
+            return resize_with(row_sse2, col_sse2, src, sw, sh, dst, dw, dh);
+#endif
+#ifdef ART_HAVE_NEON
+        case ART_RESIZE_NEON:
+            return resize_with(row_neon, col_neon, src, sw, sh, dst, dw, dh);
+#endif
+        default:
+            return resize_with(row_scalar, col_scalar, src, sw, sh, dst, dw, dh);
+    }
+}
+
+bool art_resize_supported(ArtResizeKernel kernel) {
+    switch (kernel) {
+        case ART_RESIZE_SCALAR:
+            return true;
+#ifdef ART_HAVE_SSE2
+        case ART_RESIZE_SSE2:
+            return __builtin_cpu_supports("sse2");
+#endif
+#ifdef ART_HAVE_NEON
+        case ART_RESIZE_NEON:
+#if defined(__aarch64__)
+            return true;
+#else
+            return (getauxval(AT_HWCAP) & HWCAP_NEON) != 0;
+#endif
+#endif
+        default:
+            return false;
+    }
+}
+
+const char *art_resize_kernel_name(ArtResizeKernel kernel) {
+    switch (kernel) {
+        case ART_RESIZE_SSE2: return "sse2";
+        case ART_RESIZE_NEON: return "neon";
+        default: return "scalar";
+    }
+}
+
+// compares kernel against the scalar path on a few awkward sizes
+bool art_resize_matches_scalar(ArtResizeKernel kernel) {
+    static const int sizes[][4] = {
+        { 67, 53, 29, 31 },
+        { 640, 640, 256, 256 },
+        { 320, 320, 100, 100 },
+        { 9, 9, 9, 9 },
+        { 5, 3, 11, 7 }
+    };
+
+    bool same = true;
+    for (size_t t = 0; t < sizeof(sizes) / sizeof(sizes[0]) && same; t++) {
+        int sw = sizes[t][0], sh = sizes[t][1], dw = sizes[t][2], dh = sizes[t][3];
+        uint8_t *src = malloc((size_t)sw * sh * 4);
+        uint8_t *a = malloc((size_t)dw * dh * 4);
+        uint8_t *b = malloc((size_t)dw * dh * 4);
+        if (!src || !a || !b) {
+            same = false;
+        } else {
+            uint32_t seed = 0x9E3779B9u + t;
+            for (size_t i = 0; i < (size_t)sw * sh * 4; i++) {
+                seed = seed * 1664525u + 1013904223u;
+                src[i] = seed >> 24;
+            }
+            same = resize_kernel(ART_RESIZE_SCALAR, src, sw, sh, a, dw, dh) &&
+                resize_kernel(kernel, src, sw, sh, b, dw, dh) &&
+                memcmp(a, b, (size_t)dw * dh * 4) == 0;
+        }
+        free(src);
+        free(a);
+        free(b);
+    }
+
+    return same;
+}
+
+static ArtResizeKernel active_kernel = ART_RESIZE_SCALAR;
+static pthread_once_t active_once = PTHREAD_ONCE_INIT;
+
+static void pick_kernel() {
+    const char *force = getenv("PITHING_RESIZE");
+    if (force && strcmp(force, "scalar") == 0) {
+        return;
+    }
+
+    ArtResizeKernel candidates[] = { ART_RESIZE_NEON, ART_RESIZE_SSE2 };
+    for (size_t i = 0; i < sizeof(candidates) / sizeof(candidates[0]); i++) {
+        if (!art_resize_supported(candidates[i])) {
+            continue;
+        }
+        if (!art_resize_matches_scalar(candidates[i])) {
+            fprintf(stderr, "Resize kernel %s disagrees with scalar, not using it\n",
+                art_resize_kernel_name(candidates[i]));
+            continue;
+        }
+        active_kernel = candidates[i];
+        return;
+    }
+}
+
+ArtResizeKernel art_resize_active() {
+    pthread_once(&active_once, pick_kernel);
+    return active_kernel;
+}
+
+bool art_resize_rgba_with(ArtResizeKernel kernel, const unsigned char *src, int sw, int sh,
+    unsigned char *dst, int dw, int dh) {
+    if (sw <= 0 || sh <= 0 || dw <= 0 || dh <= 0 || !art_resize_supported(kernel)) {
+        return false;
+    }
+    return resize_kernel(kernel, src, sw, sh, dst, dw, dh);
+}
+
+bool art_resize_rgba(const unsigned char *src, int sw, int sh, unsigned char *dst, int dw, int dh) {
+    return art_resize_rgba_with(art_resize_active(), src, sw, sh, dst, dw, dh);
+}
+
+bool art_resize_image(Image *image, int width, int height) {
+    if (image->format != PIXELFORMAT_UNCOMPRESSED_R8G8B8A8) {
+        ImageFormat(image, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+    }
+
+    unsigned char *pixels = art_pixels_alloc(width, height, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+    if (!pixels) {
+        return false;
+    }
+    if (!art_resize_rgba(image->data, image->width, image->height, pixels, width, height)) {
+        art_pixels_free(pixels);
+        return false;
+    }
+
+    art_pixels_free(image->data);
+    image->data = pixels;
+    image->width = width;
+    image->height = height;
+    image->mipmaps = 1;
+    return true;
+}
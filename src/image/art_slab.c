@@ -0,0 +1,114 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "art_image.h"
+
+/*
+    finished art only comes in a few sizes, so its pixel buffers are carved
+    out of one slab per size and format instead of the heap. a slab is a
+    single allocation made the first time its size is asked for and is kept
+    for the life of the process, buffers go back to it on free
+*/
+
+typedef struct {
+    int size;
+    int format;
+    int count;
+    size_t bytes;
+    unsigned char *base;
+    uint32_t used;
+} ArtSlab;
+
+static ArtSlab slabs[] = {
+    { .size = 64, .format = PIXELFORMAT_UNCOMPRESSED_R8G8B8A8, .count = 4 },
+    { .size = 100, .format = PIXELFORMAT_UNCOMPRESSED_R8G8B8A8, .count = 8 },
+    { .size = 256, .format = PIXELFORMAT_UNCOMPRESSED_R8G8B8A8, .count = 4 },
+    { .size = 64, .format = PIXELFORMAT_COMPRESSED_ETC2_RGB, .count = 8 },
+    { .size = 100, .format = PIXELFORMAT_COMPRESSED_ETC2_RGB, .count = 16 },
+    { .size = 256, .format = PIXELFORMAT_COMPRESSED_ETC2_RGB, .count = 6 },
+};
+
+#define SLAB_COUNT (int)(sizeof(slabs) / sizeof(slabs[0]))
+
+static pthread_mutex_t slab_mutex = PTHREAD_MUTEX_INITIALIZER;
+static unsigned slab_hits = 0;
+static unsigned slab_misses = 0;
+static unsigned slab_other = 0;
+
+static size_t slab_buffer_bytes(const ArtSlab *slab) {
+    size_t pixels = (size_t)slab->size * slab->size;
+    return slab->format == PIXELFORMAT_COMPRESSED_ETC2_RGB ? pixels / 2 : pixels * 4;
+}
+
+void *art_pixels_alloc(int width, int height, int format) {
+    ArtSlab *slab = NULL;
+    for (int i = 0; i < SLAB_COUNT; i++) {
+        if (slabs[i].size == width && slabs[i].size == height && slabs[i].format == format) {
+            slab = &slabs[i];
+            break;
+        }
+    }
+
+    void *pixels = NULL;
+    pthread_mutex_lock(&slab_mutex);
+    if (!slab) {
+        slab_other++;
+    } else {
+        if (!slab->base) {
+            slab->bytes = slab_buffer_bytes(slab);
+            slab->base = malloc(slab->bytes * slab->count);
+        }
+        for (int i = 0; slab->base && i < slab->count; i++) {
+            if (!(slab->used & (1u << i))) {
+                slab->used |= 1u << i;
+                pixels = slab->base + slab->bytes * i;
+                break;
+            }
+        }
+        if (pixels) {
+            slab_hits++;
+        } else {
+            slab_misses++;
+        }
+    }
+    pthread_mutex_unlock(&slab_mutex);
+
+    if (pixels) {
+        return pixels;
+    }
+
+    size_t bytes = (size_t)width * height;
+    return MemAlloc((unsigned int)(format == PIXELFORMAT_COMPRESSED_ETC2_RGB ? bytes / 2 : bytes * 4));
+}
+
+void art_pixels_free(void *pixels) {
+    if (!pixels) {
+        return;
+    }
+
+    unsigned char *p = pixels;
+    pthread_mutex_lock(&slab_mutex);
+    for (int i = 0; i < SLAB_COUNT; i++) {
+        ArtSlab *slab = &slabs[i];
+        if (slab->base && p >= slab->base && p < slab->base + slab->bytes * slab->count) {
+            slab->used &= ~(1u << ((p - slab->base) / slab->bytes));
+            pthread_mutex_unlock(&slab_mutex);
+            return;
+        }
+    }
+    pthread_mutex_unlock(&slab_mutex);
+
+    MemFree(pixels);
+}
+
+void art_image_unload(Image image) {
+    art_pixels_free(image.data);
+}
+
+void art_slab_stats(unsigned *hits, unsigned *misses, unsigned *other) {
+    pthread_mutex_lock(&slab_mutex);
+    *hits = slab_hits;
+    *misses = slab_misses;
+    *other = slab_other;
+    pthread_mutex_unlock(&slab_mutex);
+}
@@ -0,0 +1,111 @@
+/*
+    indexed loops over big arrays, for (i) cJSON_GetArrayItem(items, i), with
+    the lazy array index against the plain linked list walk it replaces and
+    against cJSON_ArrayForEach as the floor. first checks the index survives a
+    reference to its array being deleted (build with -fsanitize=address to
+    catch a use after free there)
+
+    build from the repo root:
+        gcc -O2 -o build/cjson_array_bench testing/bench/cjson_array_bench.c src/cjson/cJSON.c -lm
+    run:
+        ./build/cjson_array_bench [iterations]
+*/
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "../../src/cjson/cJSON.h"
+
+static double now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+// what cJSON_GetArrayItem did before the index
+static cJSON *walk_to(const cJSON *array, int index) {
+    cJSON *child = array->child;
+    while (child && index > 0) {
+        child = child->next;
+        index--;
+    }
+    return child;
+}
+
+// a reference shares its array's children but must never own the index
+static bool reference_keeps_index() {
+    cJSON *items = cJSON_CreateArray();
+    for (int i = 0; i < 64; i++) {
+        cJSON_AddItemToArray(items, cJSON_CreateNumber(i));
+    }
+    bool ok = cJSON_GetArrayItem(items, 10)->valueint == 10;
+
+    cJSON *holder = cJSON_CreateArray();
+    cJSON_AddItemReferenceToArray(holder, items);
+    ok = ok && cJSON_GetArrayItem(cJSON_GetArrayItem(holder, 0), 20)->valueint == 20;
+    cJSON_Delete(holder);
+
+    for (int i = 0; ok && i < 64; i++) {
+        ok = cJSON_GetArrayItem(items, i)->valueint == i;
+    }
+    ok = ok && cJSON_GetArraySize(items) == 64;
+    cJSON_Delete(items);
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    int iterations = argc > 1 ? atoi(argv[1]) : 20;
+
+    if (!reference_keeps_index()) {
+        printf("array index broken by a deleted reference\n");
+        return 1;
+    }
+    int sizes[] = { 1000, 2000, 5000, 10000 };
+
+    printf("%8s %14s %14s %14s\n", "items", "linked walk", "indexed", "ArrayForEach");
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        int n = sizes[s];
+        cJSON *items = cJSON_CreateArray();
+        for (int i = 0; i < n; i++) {
+            cJSON_AddItemToArray(items, cJSON_CreateNumber(i));
+        }
+
+        double sum = 0;
+        double start = now_ms();
+        for (int it = 0; it < iterations; it++) {
+            for (int i = 0; i < n; i++) {
+                sum += walk_to(items, i)->valuedouble;
+            }
+        }
+        double walk_ms = (now_ms() - start) / iterations;
+
+        start = now_ms();
+        for (int it = 0; it < iterations; it++) {
+            // mutating drops the index, so every pass pays for a rebuild
+            cJSON_AddItemToArray(items, cJSON_CreateNumber(0));
+            cJSON_DeleteItemFromArray(items, n);
+            for (int i = 0; i < n; i++) {
+                sum += cJSON_GetArrayItem(items, i)->valuedouble;
+            }
+        }
+        double indexed_ms = (now_ms() - start) / iterations;
+
+        start = now_ms();
+        for (int it = 0; it < iterations; it++) {
+            cJSON *item = NULL;
+            cJSON_ArrayForEach(item, items) {
+                sum += item->valuedouble;
+            }
+        }
+        double foreach_ms = (now_ms() - start) / iterations;
+
+        printf("%8d %11.3f ms %11.3f ms %11.3f ms\n", n, walk_ms, indexed_ms, foreach_ms);
+        if (sum < 0) {
+            printf("%f\n", sum);
+        }
+        cJSON_Delete(items);
+    }
+
+    return 0;
+}
@@ -0,0 +1,110 @@
+/*
+    parses recorded api responses with cJSON_Parse and with cJSON_ParseArena,
+    each with and without the keys spotify.c skips, and reports time and heap
+    allocations per parse + delete
+
+    build from the repo root:
+        gcc -O2 -o build/cjson_bench testing/bench/cjson_bench.c src/cjson/cJSON.c -lm
+    run (defaults to the payloads in testing/bench/data):
+        ./build/cjson_bench [iterations] [file.json ...]
+*/
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../../src/cjson/cJSON.h"
+
+static unsigned long allocations = 0;
+
+static void *counting_malloc(size_t size) {
+    allocations++;
+    return malloc(size);
+}
+
+static double now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static char *read_file(const char *path, size_t *size) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    long length = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *data = malloc(length + 1);
+    if (data && fread(data, 1, length, f) != (size_t)length) {
+        free(data);
+        data = NULL;
+    }
+    fclose(f);
+    if (data) {
+        data[length] = '\0';
+        *size = length;
+    }
+    return data;
+}
+
+// the fields spotify.c leaves out of every api response
+static const char *skip_keys[] = { "available_markets", "external_ids", "external_urls", NULL };
+
+// average ms per parse + delete, allocations per parse in *allocs
+static double time_parse(const char *json, size_t size, int iterations, bool arena, bool skip, unsigned long *allocs) {
+    allocations = 0;
+    double start = now_ms();
+    for (int i = 0; i < iterations; i++) {
+        cJSON *root = cJSON_ParseWithSkipKeys(json, size, skip ? skip_keys : NULL, arena);
+        if (!root) {
+            fprintf(stderr, "  parse failed\n");
+            break;
+        }
+        cJSON_Delete(root);
+    }
+    *allocs = allocations / iterations;
+    return (now_ms() - start) / iterations;
+}
+
+static void bench(const char *path, int iterations) {
+    size_t size = 0;
+    char *json = read_file(path, &size);
+    if (!json) {
+        fprintf(stderr, "can't read %s\n", path);
+        return;
+    }
+
+    printf("%s (%zu bytes), %d iterations\n", path, size, iterations);
+
+    unsigned long heap_allocs, arena_allocs, heap_skip_allocs, arena_skip_allocs;
+    double heap_ms = time_parse(json, size, iterations, false, false, &heap_allocs);
+    double arena_ms = time_parse(json, size, iterations, true, false, &arena_allocs);
+    double heap_skip_ms = time_parse(json, size, iterations, false, true, &heap_skip_allocs);
+    double arena_skip_ms = time_parse(json, size, iterations, true, true, &arena_skip_allocs);
+
+    printf("  cJSON_Parse:              %8.4f ms  %6lu mallocs\n", heap_ms, heap_allocs);
+    printf("  cJSON_ParseArena:         %8.4f ms  %6lu mallocs\n", arena_ms, arena_allocs);
+    printf("  cJSON_Parse, skip keys:   %8.4f ms  %6lu mallocs\n", heap_skip_ms, heap_skip_allocs);
+    printf("  arena, skip keys:         %8.4f ms  %6lu mallocs\n", arena_skip_ms, arena_skip_allocs);
+    printf("  speedup:                  %8.2fx arena, %.2fx arena + skip\n", heap_ms / arena_ms, heap_ms / arena_skip_ms);
+    free(json);
+}
+
+int main(int argc, char **argv) {
+    int iterations = argc > 1 ? atoi(argv[1]) : 2000;
+    cJSON_Hooks hooks = { counting_malloc, free };
+    cJSON_InitHooks(&hooks);
+
+    if (argc > 2) {
+        for (int i = 2; i < argc; i++) {
+            bench(argv[i], iterations);
+        }
+    } else {
+        bench("testing/bench/data/me_player.json", iterations);
+        bench("testing/bench/data/playlists.json", iterations);
+    }
+    return 0;
+}
@@ -0,0 +1,73 @@
+/*
+    compares the old album art path (stb decode at full size + ImageResize)
+    with the libjpeg scaled decode used by load_album_art
+
+    build from the repo root:
+        gcc -O2 -o build/jpeg_bench testing/bench/jpeg_bench.c src/image/art_image.c \
+            -L/usr/local/lib -lraylib -ljpeg -lGL -lm -lpthread -ldl -lrt -lX11
+    run with a saved i.scdn.co image, e.g. a 640x640 cover:
+        ./build/jpeg_bench cover.jpg 256 200
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "raylib.h"
+#include "../../src/image/art_image.h"
+
+static double now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s image.jpg [target] [iterations]\n", argv[0]);
+        return 1;
+    }
+
+    int target = argc > 2 ? atoi(argv[2]) : 256;
+    int iterations = argc > 3 ? atoi(argv[3]) : 100;
+
+    int size = 0;
+    unsigned char *data = LoadFileData(argv[1], &size);
+    if (!data || !art_is_jpeg(data, size)) {
+        fprintf(stderr, "%s is not a jpeg\n", argv[1]);
+        return 1;
+    }
+
+    SetTraceLogLevel(LOG_WARNING);
+
+    double start = now_ms();
+    for (int i = 0; i < iterations; i++) {
+        Image img = LoadImageFromMemory(".jpg", data, size);
+        ImageResize(&img, target, target);
+        UnloadImage(img);
+    }
+    double stb_ms = (now_ms() - start) / iterations;
+
+    int decoded_width = 0;
+    start = now_ms();
+    for (int i = 0; i < iterations; i++) {
+        Image img = {0};
+        if (!art_decode_jpeg(data, size, target, &img)) {
+            fprintf(stderr, "scaled decode failed\n");
+            return 1;
+        }
+        decoded_width = img.width;
+        if (img.width != target || img.height != target) {
+            ImageResize(&img, target, target);
+        }
+        UnloadImage(img);
+    }
+    double scaled_ms = (now_ms() - start) / iterations;
+
+    printf("%s -> %dx%d, %d iterations\n", argv[1], target, target, iterations);
+    printf("  stb + ImageResize:        %8.3f ms\n", stb_ms);
+    printf("  scaled decode (%4dpx) +  %8.3f ms\n", decoded_width, scaled_ms);
+    printf("  speedup:                  %8.2fx\n", stb_ms / scaled_ms);
+
+    UnloadFileData(data);
+    return 0;
+}
@@ -0,0 +1,92 @@
+/*
+    times raylib's ImageResize against every art_resize kernel this cpu supports
+    for the two downscales album art goes through, and checks each simd kernel
+    is byte for byte identical to the scalar one
+
+    build from the repo root (add -mfpu=neon on 32 bit arm to get the neon kernel):
+        gcc -O2 -o build/resize_bench testing/bench/resize_bench.c src/image/art_resize.c src/image/art_slab.c \
+            -L/usr/local/lib -lraylib -lGL -lm -lpthread -ldl -lrt -lX11
+    run:
+        ./build/resize_bench [iterations]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "raylib.h"
+#include "../../src/image/art_image.h"
+
+#define SRC_SIZE 640
+
+static double now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static Image make_source() {
+    // smooth gradients plus noise, roughly what a cover looks like to a box filter
+    Image img = GenImageColor(SRC_SIZE, SRC_SIZE, BLACK);
+    unsigned char *px = img.data;
+    unsigned int seed = 12345;
+    for (int y = 0; y < SRC_SIZE; y++) {
+        for (int x = 0; x < SRC_SIZE; x++) {
+            seed = seed * 1664525u + 1013904223u;
+            unsigned char *p = &px[(y * SRC_SIZE + x) * 4];
+            p[0] = (x * 255) / SRC_SIZE;
+            p[1] = (y * 255) / SRC_SIZE;
+            p[2] = seed >> 24;
+            p[3] = 255;
+        }
+    }
+    return img;
+}
+
+int main(int argc, char **argv) {
+    int iterations = argc > 1 ? atoi(argv[1]) : 100;
+    int targets[] = { 256, 100 };
+    ArtResizeKernel kernels[] = { ART_RESIZE_SCALAR, ART_RESIZE_SSE2, ART_RESIZE_NEON };
+
+    SetTraceLogLevel(LOG_WARNING);
+    Image source = make_source();
+    printf("runtime pick: %s\n", art_resize_kernel_name(art_resize_active()));
+
+    for (size_t t = 0; t < sizeof(targets) / sizeof(targets[0]); t++) {
+        int size = targets[t];
+        printf("%d -> %d, %d iterations\n", SRC_SIZE, size, iterations);
+
+        double start = now_ms();
+        for (int i = 0; i < iterations; i++) {
+            Image copy = ImageCopy(source);
+            ImageResize(&copy, size, size);
+            UnloadImage(copy);
+        }
+        printf("  %-8s %8.3f ms\n", "raylib", (now_ms() - start) / iterations);
+
+        unsigned char *reference = malloc(size * size * 4);
+        unsigned char *out = malloc(size * size * 4);
+        art_resize_rgba_with(ART_RESIZE_SCALAR, source.data, SRC_SIZE, SRC_SIZE, reference, size, size);
+
+        for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+            if (!art_resize_supported(kernels[k])) {
+                continue;
+            }
+
+            start = now_ms();
+            for (int i = 0; i < iterations; i++) {
+                art_resize_rgba_with(kernels[k], source.data, SRC_SIZE, SRC_SIZE, out, size, size);
+            }
+            double ms = (now_ms() - start) / iterations;
+            bool exact = memcmp(out, reference, size * size * 4) == 0;
+            printf("  %-8s %8.3f ms  %s\n", art_resize_kernel_name(kernels[k]), ms,
+                exact ? "bit exact" : "MISMATCH");
+        }
+
+        free(reference);
+        free(out);
+    }
+
+    UnloadImage(source);
+    return 0;
+}